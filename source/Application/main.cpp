@@ -8,6 +8,7 @@
 #include "imgui_impl_opengl3.h"
 
 #include "Application/Services/ImGuiService.h"
+#include "TestFramework/TestForkServer.h"
 
 
 
@@ -25,6 +26,9 @@
 
 int main()
 {
+    // Worker processes are forked from here on, before glfw or anything else can start a thread
+    lsn::test_framework::TestForkServer::Start();
+
     /* Initialize the library */
     if (!glfwInit())
         return -1;
@@ -5,6 +5,9 @@
 #include "TestFramework/TestObject.h"
 
 #include <algorithm>
+#include <array>
+#include <climits>
+#include <format>
 
 using namespace lsn::test_framework;
 
@@ -31,9 +34,9 @@ void OpenTestFileToIssue(const TestObject& test)
 	int lineNumber = test.LineNumber;
 	if (const auto* result = TestManager::Instance().FetchResult(&test))
 	{
-		if (result->_lastFailure)
+		if (auto failure = result->LastFailure())
 		{
-			lineNumber = result->_lastFailure->linenumber();
+			lineNumber = failure->linenumber();
 		}
 	}
 
@@ -46,7 +49,23 @@ void Edit(TestExecutionOptions& options)
 {
 	ImGui::SliderInt("MaxNumberOfSimultaneousThreads", &options.MaxNumberOfSimultaneousThreads, 0, 12);
 	ImGui::SliderInt("MinimumNumberOfTestsPerThread", &options.MinimumNumberOfTestsPerThread, 1, 30);
-	
+
+	int isolation = static_cast<int>(options.Isolation);
+	if (ImGui::Combo("Isolation", &isolation, "Thread\0Process\0Zygote\0Distributed\0"))
+		options.Isolation = static_cast<TestIsolation>(isolation);
+
+	ImGui::SliderInt("ShardCount", &options.Shard.Count, 1, 16);
+	options.Shard.Index = std::min(options.Shard.Index, options.Shard.Count - 1);
+	ImGui::SliderInt("ShardIndex", &options.Shard.Index, 0, options.Shard.Count - 1);
+
+	// empty balances the shards by the history instead
+	std::array<char, 260> durations{};
+	options.Shard.DurationsFile.string().copy(durations.data(), durations.size() - 1);
+	if (ImGui::InputText("DurationsFile", durations.data(), durations.size()))
+		options.Shard.DurationsFile = durations.data();
+
+	ImGui::Checkbox("AcceptBaselines", &options.AcceptBaselines);
+
 	// TODO: Expose to xenum
 	// ImGui::Combo("MaximumConcurrency", options.MaximumConcurrency);
 	// ImGui::Combo("EnforcedConcurrency", options.EnforcedConcurrency);
@@ -70,6 +89,56 @@ constexpr ImVec4 ToColor(TestResultStatus status)
 	return TestStatusColors::NotRun;
 }
 
+constexpr ImVec4 ToColor(TestInstanceResults::Outcome outcome)
+{
+	switch (outcome)
+	{
+		case TestInstanceResults::Outcome::Passed: return TestStatusColors::Passed;
+		case TestInstanceResults::Outcome::Failed: return TestStatusColors::Failed;
+		case TestInstanceResults::Outcome::NotRun: return TestStatusColors::NotRun;
+	}
+
+	return TestStatusColors::NotRun;
+}
+
+constexpr const char* ToCString(TestInstanceResults::Outcome outcome)
+{
+	switch (outcome)
+	{
+		case TestInstanceResults::Outcome::Passed: return "Passed";
+		case TestInstanceResults::Outcome::Failed: return "Failed";
+		case TestInstanceResults::Outcome::NotRun: return "NotRun";
+	}
+
+	return "<unknown>";
+}
+
+// A row per instance, only the ones on screen are described
+void DisplayInstances(const TestDefinition& definition, const TestInstanceResults& instances)
+{
+	ImGui::Text("%llu passed %llu failed", (unsigned long long)instances.NumPassed(), (unsigned long long)instances.NumFailed());
+
+	auto node = ImGui::Scoped::TreeNode("Instances");
+	if (!node)
+		return;
+
+	ImGuiListClipper clipper;
+	clipper.Begin((int)std::min<uint64_t>(definition.NumInstances, INT_MAX));
+	while (clipper.Step())
+	{
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+		{
+			auto outcome = instances.OutcomeOf(i);
+			ImGui::TextColored(ToColor(outcome), "%s %s", definition._describe(i).c_str(), ToCString(outcome));
+			if (auto failure = instances.FailureOf(i))
+			{
+				ImGui::SameLine();
+				ImGui::TextColored(TestStatusColors::Failed, "%s", failure->FormattedString().c_str());
+			}
+		}
+	}
+}
+
 constexpr const char* ToCString(TestConcurrency concurrency)
 {
 	switch (concurrency)
@@ -97,7 +166,7 @@ void ImGuiPanel_TestManager::OnImGui()
 
 	Edit(testManager.TestOptions);
 
-	for (const auto& category : testManager._categories)
+	for (const auto& category : testManager.Categories())
 		OnImGui(category);
 }
 
@@ -124,14 +193,20 @@ void ImGuiPanel_TestManager::OnImGui(const TestObject& test)
 	auto id = ImGui::Scoped::Id(test.Id);
 	auto status = TestManager::Instance().DetermineStatus(&test);
 
-	if (test.Children.size())
+	if (test.Children.size() || test.IsPending())
 	{
 		auto cs = ImGui::Scoped::TreeNode(test.Name.c_str());
 		ImGui::SameLine();
 		DisplayTestDetails(test, status);
+		ImGui::SameLine();
+		ImGui::Text("%u/%u passed", test.Counts[TestResultStatus::Passed], test.Counts.Total());
 
 		if (cs)
 		{
+			// parameterized tests only create their instances once they're opened
+			if (test.IsPending())
+				TestManager::Instance().Expand(test);
+
 			auto indent = ImGui::Scoped::Indent(0.1f);
 
 			// order the results based on depth of sub results.
@@ -147,6 +222,11 @@ void ImGuiPanel_TestManager::OnImGui(const TestObject& test)
 	else if (test.Definition)
 	{
 		ImGui::Text("%s (%s)", test.Name.c_str(), ToCString(test.Definition->Concurrency));
+		if (test.Definition->NumInstances > 0)
+		{
+			ImGui::SameLine();
+			ImGui::Text("%llu instances", (unsigned long long)test.Definition->NumInstances);
+		}
 		ImGui::SameLine();
 		DisplayTestDetails(test, status);
 
@@ -155,13 +235,54 @@ void ImGuiPanel_TestManager::OnImGui(const TestObject& test)
 		{
 			ImGui::SameLine();
 			ImGui::Text("Time Taken %d (ns)", result->TimeTaken());
+
+			auto measured = result->Measurements();
+			if (measured && measured->Benchmark)
+			{
+				const auto& benchmark = *measured->Benchmark;
+				ImGui::Text("mean %.1fns median %.1fns stddev %.1fns p90 %.1fns p99 %.1fns (%llu iterations)",
+					benchmark.Mean.count(), benchmark.Median.count(), benchmark.StdDev.count(),
+					benchmark.P90.count(), benchmark.P99.count(), (unsigned long long)benchmark.Iterations);
+			}
+
+			if (measured && measured->Counters)
+			{
+				const auto& counters = *measured->Counters;
+				std::string text;
+				for (auto counter : XEnumTraits<TestCounter>::Values)
+				{
+					if (counters.IsAvailable(counter))
+						text += std::format("{}{} {}", text.empty() ? "" : " ", XEnumTraits<TestCounter>::ToCString(counter), counters[counter]);
+				}
+				ImGui::Text("%s", text.c_str());
+			}
+
+			if (measured && measured->Allocations)
+			{
+				const auto& allocations = *measured->Allocations;
+				ImGui::Text("%llu allocations %llu frees %llu bytes (peak %llu)",
+					(unsigned long long)allocations.Allocations, (unsigned long long)allocations.Deallocations,
+					(unsigned long long)allocations.Bytes, (unsigned long long)allocations.PeakBytes);
+			}
+
+			if (measured && measured->Usage)
+			{
+				const auto& usage = *measured->Usage;
+				ImGui::Text("cpu %lld (ns) %.0f%% of wall, faults %llu minor %llu major, switches %llu voluntary %llu involuntary",
+					(long long)usage.CpuTime.count(), usage.CpuShare() * 100.0,
+					(unsigned long long)usage.MinorFaults, (unsigned long long)usage.MajorFaults,
+					(unsigned long long)usage.VoluntarySwitches, (unsigned long long)usage.InvoluntarySwitches);
+			}
+
+			if (auto instances = result->Instances(); instances && test.Definition->NumInstances > 0)
+				DisplayInstances(*test.Definition, *instances);
 		}
 
 		if (status == TestResultStatus::Failed)
 		{
-			const auto& failure = result->_lastFailure.value();
-			// Print the error message
-			ImGui::TextColored(TestStatusColors::Failed, failure.FormattedString().c_str());
+			// Print the error message, the test may have been rerun since its status was determined
+			if (auto failure = result->LastFailure())
+				ImGui::TextColored(TestStatusColors::Failed, failure->FormattedString().c_str());
 		}
 	}
 }
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace lsn::test_framework
+{
+	// A fixed run of bits that any thread can set, clear and test without locks
+	class AtomicBitset
+	{
+	public:
+		// Makes room for at least numBits, clearing every bit if it has to grow.
+		// Not thread safe, only call while nothing else is using the bitset.
+		void Reserve(size_t numBits)
+		{
+			if (numBits <= Size())
+				return;
+
+			_numWords = (numBits + 63) / 64;
+			_words = std::make_unique<std::atomic<uint64_t>[]>(_numWords);
+		}
+
+		size_t Size() const { return _numWords * 64; }
+
+		void Set(size_t bit)
+		{
+			_words[bit / 64].fetch_or(Mask(bit), std::memory_order_release);
+		}
+
+		// Sets the bit, returning whether it already was, so only one of the threads racing to set it sees it clear
+		bool TestAndSet(size_t bit)
+		{
+			return (_words[bit / 64].fetch_or(Mask(bit), std::memory_order_acq_rel) & Mask(bit)) != 0;
+		}
+
+		void Reset(size_t bit)
+		{
+			_words[bit / 64].fetch_and(~Mask(bit), std::memory_order_release);
+		}
+
+		// Out of range bits are never set
+		bool Test(size_t bit) const
+		{
+			return bit < Size() && (_words[bit / 64].load(std::memory_order_acquire) & Mask(bit)) != 0;
+		}
+
+		void ResetAll()
+		{
+			for (size_t i = 0; i < _numWords; ++i)
+				_words[i].store(0, std::memory_order_release);
+		}
+
+	private:
+		static uint64_t Mask(size_t bit) { return uint64_t(1) << (bit % 64); }
+
+		std::unique_ptr<std::atomic<uint64_t>[]> _words;
+		size_t _numWords = 0;
+	};
+}
@@ -0,0 +1,211 @@
+#include "TestAllocations.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined ELISION_TRACK_ALLOCATIONS
+#if defined __GLIBC__
+#include <malloc.h>
+#elif defined _MSC_VER
+#include <malloc.h>
+#else
+#error ELISION_TRACK_ALLOCATIONS needs glibc or the msvc runtime
+#endif
+#endif
+
+namespace lsn::test_framework
+{
+
+namespace
+{
+	// A plain pointer, so reading it never allocates, whichever allocation it's read for
+	thread_local AllocationCounter* t_current = nullptr;
+}
+
+TestAllocations::Scope::Scope(AllocationCounter& counter)
+	: _counter(counter)
+	, _outer(t_current)
+{
+	t_current = &_counter;
+}
+
+TestAllocations::Scope::~Scope()
+{
+	t_current = _outer;
+	if (!_outer)
+		return;
+
+	_outer->Peak = std::max(_outer->Peak, _outer->Live + _counter.Peak);
+	_outer->Allocations += _counter.Allocations;
+	_outer->Deallocations += _counter.Deallocations;
+	_outer->Bytes += _counter.Bytes;
+	_outer->Live += _counter.Live;
+}
+
+bool TestAllocations::IsHooked()
+{
+#if defined ELISION_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+}
+
+#if defined ELISION_TRACK_ALLOCATIONS
+
+namespace
+{
+	using lsn::test_framework::t_current;
+
+	void Allocated(size_t size)
+	{
+		if (auto* counter = t_current)
+		{
+			counter->Allocations++;
+			counter->Bytes += size;
+			counter->Live += static_cast<int64_t>(size);
+			counter->Peak = std::max(counter->Peak, counter->Live);
+		}
+	}
+
+	void Freed(size_t size)
+	{
+		if (auto* counter = t_current)
+		{
+			counter->Deallocations++;
+			counter->Live -= static_cast<int64_t>(size);
+		}
+	}
+}
+
+#if defined __GLIBC__
+
+// glibc lets the program supply its own malloc, which everything, operator new and glibc itself included,
+// then calls. These count and pass on to glibc's own.
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* pointer, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void* pointer);
+
+	void* malloc(size_t size) noexcept
+	{
+		void* pointer = __libc_malloc(size);
+		if (pointer)
+			Allocated(malloc_usable_size(pointer));
+		return pointer;
+	}
+
+	void* calloc(size_t count, size_t size) noexcept
+	{
+		void* pointer = __libc_calloc(count, size);
+		if (pointer)
+			Allocated(malloc_usable_size(pointer));
+		return pointer;
+	}
+
+	// a reallocation is a new allocation in place of the old one
+	void* realloc(void* pointer, size_t size) noexcept
+	{
+		size_t previous = pointer ? malloc_usable_size(pointer) : 0;
+		void* reallocated = __libc_realloc(pointer, size);
+		if (pointer && (reallocated || size == 0))
+			Freed(previous);
+		if (reallocated)
+			Allocated(malloc_usable_size(reallocated));
+		return reallocated;
+	}
+
+	void* memalign(size_t alignment, size_t size) noexcept
+	{
+		void* pointer = __libc_memalign(alignment, size);
+		if (pointer)
+			Allocated(malloc_usable_size(pointer));
+		return pointer;
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) noexcept
+	{
+		return memalign(alignment, size);
+	}
+
+	int posix_memalign(void** result, size_t alignment, size_t size) noexcept
+	{
+		if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+			return EINVAL;
+
+		void* pointer = memalign(alignment, size);
+		if (!pointer)
+			return ENOMEM;
+		*result = pointer;
+		return 0;
+	}
+
+	void free(void* pointer) noexcept
+	{
+		if (pointer)
+			Freed(malloc_usable_size(pointer));
+		__libc_free(pointer);
+	}
+}
+
+#else
+
+// The msvc runtime's malloc can't be replaced, so only operator new and delete are counted
+namespace
+{
+	void* Allocate(size_t size)
+	{
+		void* pointer = std::malloc(size ? size : 1);
+		if (pointer)
+			Allocated(_msize(pointer));
+		return pointer;
+	}
+
+	void Deallocate(void* pointer)
+	{
+		if (pointer)
+			Freed(_msize(pointer));
+		std::free(pointer);
+	}
+}
+
+void* operator new(size_t size)
+{
+	if (void* pointer = Allocate(size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void operator delete(void* pointer) noexcept { Deallocate(pointer); }
+void operator delete[](void* pointer) noexcept { Deallocate(pointer); }
+void operator delete(void* pointer, size_t) noexcept { Deallocate(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { Deallocate(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { Deallocate(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { Deallocate(pointer); }
+
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+// Heap allocations made by each test, counted by a replacement of the global allocator. Replacing it is a
+// whole program decision, so it's opt in: build with ELISION_TRACK_ALLOCATIONS defined to install the hook.
+// With glibc malloc and its family are hooked, which operator new goes through, elsewhere only operator new
+// and delete are. Without the hook tests have no allocation statistics and their budgets aren't enforced.
+namespace lsn::test_framework
+{
+	// Bytes are as the allocator hands them out, which can be a little more than was asked for
+	struct AllocationStatistics
+	{
+		uint64_t Allocations = 0;
+		uint64_t Deallocations = 0;
+		uint64_t Bytes = 0; // allocated over the whole test
+		uint64_t PeakBytes = 0; // the most the test had allocated and not yet freed at any one time
+	};
+
+	static_assert(std::is_trivially_copyable_v<AllocationStatistics>);
+
+	// Counts whatever the calling thread allocates while it's current. Only ever touched by its thread.
+	struct AllocationCounter
+	{
+		uint64_t Allocations = 0;
+		uint64_t Deallocations = 0;
+		uint64_t Bytes = 0;
+		int64_t Live = 0; // negative when freeing what was allocated before the counting started
+		int64_t Peak = 0;
+
+		AllocationStatistics Statistics() const
+		{
+			return { Allocations, Deallocations, Bytes, static_cast<uint64_t>(Peak) };
+		}
+	};
+
+	struct TestAllocations
+	{
+		// Makes the counter current on the calling thread for its lifetime. Scopes nest, a test run from inside
+		// another has its allocations added to the outer test's once it's done.
+		class Scope
+		{
+		public:
+			explicit Scope(AllocationCounter& counter);
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			AllocationCounter& _counter;
+			AllocationCounter* _outer;
+		};
+
+		// Whether the allocator was replaced, built with ELISION_TRACK_ALLOCATIONS
+		static bool IsHooked();
+	};
+}
@@ -0,0 +1,208 @@
+#include "TestBaselines.h"
+
+#include "TestRunner.h"
+#include "TestResult.h"
+#include "TestHistory.h"
+#include "TestDefinition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+namespace lsn::test_framework
+{
+
+namespace
+{
+	double Median(std::span<const double> samples)
+	{
+		std::vector<double> sorted(samples.begin(), samples.end());
+		std::sort(sorted.begin(), sorted.end());
+		auto middle = sorted.size() / 2;
+		return sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+	}
+}
+
+// One benchmark per line: "<count> <sample ns>... <path>", the path goes last as it can contain spaces
+bool TestBaselines::Load(const std::filesystem::path& file)
+{
+	std::ifstream stream(file);
+	if (!stream)
+		return false;
+
+	size_t count;
+	while (stream >> count)
+	{
+		std::vector<double> samples(count);
+		for (auto& sample : samples)
+			stream >> sample;
+
+		std::string key;
+		if (!std::getline(stream >> std::ws, key))
+			break;
+		_entries[key] = std::move(samples);
+	}
+
+	return true;
+}
+
+bool TestBaselines::Save(const std::filesystem::path& file) const
+{
+	std::ofstream stream(file, std::ios::trunc);
+	if (!stream)
+		return false;
+
+	for (const auto& [key, samples] : _entries)
+	{
+		stream << samples.size();
+		for (double sample : samples)
+			stream << ' ' << std::format("{}", sample);
+		stream << ' ' << key << '\n';
+	}
+
+	return static_cast<bool>(stream);
+}
+
+void TestBaselines::Record(const std::string& key, std::span<const double> samples)
+{
+	_entries[key].assign(samples.begin(), samples.end());
+}
+
+const std::vector<double>* TestBaselines::Find(const std::string& key) const
+{
+	auto it = _entries.find(key);
+	return it == _entries.end() ? nullptr : &it->second;
+}
+
+void TestBaselines::Gate(std::span<TestContext> tests, const TestExecutionOptions& options)
+{
+	for (auto& context : tests)
+	{
+		const auto& definition = *context.Definition;
+		if (!context.Result->HasRun() || !definition._parent)
+			continue;
+
+		auto key = TestHistory::KeyOf(*definition._parent);
+
+		// Each instance of a parameterized benchmark has a baseline of its own, keyed on its index. The instances
+		// that failed have nothing to compare, and a regression doesn't hide the failure of the test.
+		if (auto instances = context.Result->Instances(); instances && definition.NumInstances > 0)
+		{
+			auto recorded = instances->Read();
+			std::optional<std::string> regression;
+			size_t numRegressed = 0;
+			for (const auto& [index, benchmark] : recorded.Benchmarks)
+			{
+				if (instances->OutcomeOf(index) != TestInstanceResults::Outcome::Passed)
+					continue;
+
+				if (auto regressed = Check(std::format("{}[{}]", key, index), benchmark.Recorded(), options); regressed && numRegressed++ == 0)
+					regression = std::format("{}: {}", definition._describe(index), *regressed);
+			}
+
+			// already named by its instance
+			if (regression && context.Result->HasPassed())
+			{
+				auto reason = numRegressed > 1 ? std::format("{}, and {} more instances regressed", *regression, numRegressed - 1) : *regression;
+				context.SetFailure(test_failure(reason, definition._parent->File, definition._parent->LineNumber));
+			}
+			continue;
+		}
+
+		auto measured = context.Result->Measurements();
+		if (!measured || !measured->Benchmark || !context.Result->HasPassed())
+			continue;
+
+		if (auto regressed = Check(key, measured->Benchmark->Recorded(), options))
+			context.SetFailure(*regressed);
+	}
+}
+
+std::optional<std::string> TestBaselines::Check(const std::string& key, std::span<const double> current, const TestExecutionOptions& options)
+{
+	const auto* baseline = Find(key);
+	if (!baseline || options.AcceptBaselines)
+	{
+		Record(key, current);
+		return std::nullopt;
+	}
+
+	auto comparison = Compare(*baseline, current, options.RegressionThreshold, options.RegressionSignificance);
+	if (comparison.Regressed)
+	{
+		return std::format("{:.1f}% slower than its baseline, median {:.1f}ns against {:.1f}ns (p = {:.4f})",
+			(comparison.Ratio - 1.0) * 100.0, Median(current), Median(*baseline), comparison.PValue);
+	}
+
+	if (comparison.Improved)
+		Record(key, current);
+	return std::nullopt;
+}
+
+BenchmarkComparison TestBaselines::Compare(std::span<const double> baseline, std::span<const double> current, double threshold, double significance)
+{
+	BenchmarkComparison comparison;
+	if (baseline.empty() || current.empty())
+		return comparison;
+
+	auto baselineMedian = Median(baseline);
+	comparison.Ratio = baselineMedian > 0 ? Median(current) / baselineMedian : 1.0;
+	comparison.PValue = MannWhitney(baseline, current);
+	comparison.Regressed = comparison.PValue < significance && comparison.Ratio > 1.0 + threshold;
+
+	// faster is the same test the other way around
+	comparison.Improved = MannWhitney(current, baseline) < significance && comparison.Ratio < 1.0 / (1.0 + threshold);
+	return comparison;
+}
+
+double TestBaselines::MannWhitney(std::span<const double> baseline, std::span<const double> current)
+{
+	const double n1 = static_cast<double>(baseline.size());
+	const double n2 = static_cast<double>(current.size());
+	if (n1 == 0 || n2 == 0)
+		return 1.0;
+
+	// rank everything together, tied samples share the mean of their ranks
+	struct Sample { double Value; bool Current; };
+	std::vector<Sample> samples;
+	samples.reserve(baseline.size() + current.size());
+	for (double value : baseline)
+		samples.push_back({ value, false });
+	for (double value : current)
+		samples.push_back({ value, true });
+	std::sort(samples.begin(), samples.end(), [](const Sample& lhs, const Sample& rhs) { return lhs.Value < rhs.Value; });
+
+	double currentRanks = 0.0;
+	double ties = 0.0;
+	for (size_t begin = 0; begin < samples.size(); )
+	{
+		size_t end = begin;
+		while (end < samples.size() && samples[end].Value == samples[begin].Value)
+			++end;
+
+		double rank = (begin + 1 + end) / 2.0;
+		for (size_t i = begin; i < end; ++i)
+			currentRanks += samples[i].Current ? rank : 0.0;
+
+		double tied = static_cast<double>(end - begin);
+		ties += tied * tied * tied - tied;
+		begin = end;
+	}
+
+	// U of the current samples is large when they tend to be slower
+	const double n = n1 + n2;
+	const double u = currentRanks - n2 * (n2 + 1) / 2;
+	const double mean = n1 * n2 / 2;
+	const double variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)));
+	if (variance <= 0)
+		return 1.0;
+
+	// continuity corrected, then the upper tail of the normal
+	const double z = (u - mean - 0.5) / std::sqrt(variance);
+	return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lsn::test_framework
+{
+	struct TestContext;
+	struct TestExecutionOptions;
+
+	struct BenchmarkComparison
+	{
+		double Ratio = 1.0; // the current median over the baseline's
+		double PValue = 1.0; // one sided, that the current samples are no slower than the baseline's
+		bool Regressed = false;
+		bool Improved = false;
+	};
+
+	// The samples of each benchmark's accepted run, keyed on its full path like TestHistory, with the index appended
+	// for each instance of a parameterized benchmark.
+	// A benchmark is compared against its baseline after every session, failing if it's got slower. The baseline
+	// is only replaced once a benchmark has got faster, so a slow drift can't creep in a run at a time.
+	// Only touched by the runner between tests, so it isn't synchronized.
+	struct TestBaselines
+	{
+		bool Load(const std::filesystem::path& file);
+		bool Save(const std::filesystem::path& file) const;
+
+		void Record(const std::string& key, std::span<const double> samples);
+		const std::vector<double>* Find(const std::string& key) const;
+
+		// Fails the benchmarks that are slower than their baselines, and records a baseline for those without one.
+		// Accepting records them all instead.
+		void Gate(std::span<TestContext> tests, const TestExecutionOptions& options);
+
+		// Slower needs both a Mann-Whitney U test at the significance, and the median to be at least threshold slower
+		static BenchmarkComparison Compare(std::span<const double> baseline, std::span<const double> current, double threshold, double significance);
+
+		// The one sided p-value of the current samples being no slower than the baseline's, by the normal
+		// approximation of U with a correction for ties
+		static double MannWhitney(std::span<const double> baseline, std::span<const double> current);
+
+		size_t Size() const { return _entries.size(); }
+
+	private:
+		// Records the samples as the baseline should they be the first, or the better, otherwise the regression
+		std::optional<std::string> Check(const std::string& key, std::span<const double> current, const TestExecutionOptions& options);
+
+		std::unordered_map<std::string, std::vector<double>> _entries;
+	};
+}
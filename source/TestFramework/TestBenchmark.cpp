@@ -0,0 +1,111 @@
+#include "TestBenchmark.h"
+
+#include "TestRunner.h"
+#include "TestResult.h"
+#include "TestCancellation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace lsn::test_framework
+{
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::chrono::nanoseconds Time(const std::function<void()>& body, uint64_t iterations)
+	{
+		auto start = Clock::now();
+		for (uint64_t i = 0; i < iterations; ++i)
+			body();
+		return Clock::now() - start;
+	}
+
+	// Linear between the two closest samples
+	double Percentile(std::span<const double> sorted, double percentile)
+	{
+		double rank = percentile * (sorted.size() - 1);
+		size_t lower = static_cast<size_t>(rank);
+		size_t upper = std::min(lower + 1, sorted.size() - 1);
+		return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - lower);
+	}
+}
+
+BenchmarkStatistics TestBenchmark::Measure(const std::function<void()>& body, const BenchmarkOptions& options)
+{
+	// Doubling the batch until the warmup is over also gives an estimate of the cost of an iteration
+	uint64_t warmupIterations = 0;
+	std::chrono::nanoseconds warmupTaken{ 0 };
+	for (uint64_t batch = 1; warmupIterations == 0 || warmupTaken < options.Warmup; batch *= 2)
+	{
+		CheckCancelled();
+		warmupTaken += Time(body, batch);
+		warmupIterations += batch;
+	}
+
+	auto estimate = std::max<std::chrono::nanoseconds>(warmupTaken / warmupIterations, std::chrono::nanoseconds(1));
+	auto maxSamples = std::clamp(options.MaxSamples, 1u, BenchmarkStatistics::MaxRecordedSamples);
+	auto perSample = options.TargetTime / maxSamples;
+	uint64_t iterationsPerSample = std::max<uint64_t>(perSample / estimate, 1);
+
+	// Stops at MaxSamples, or sooner once the target is reached should the warmup have underestimated
+	std::vector<double> samples;
+	samples.reserve(maxSamples);
+	std::chrono::nanoseconds taken{ 0 };
+	while (samples.size() < options.MinSamples || (samples.size() < maxSamples && taken < options.TargetTime))
+	{
+		CheckCancelled();
+		auto sample = Time(body, iterationsPerSample);
+		taken += sample;
+		samples.push_back(static_cast<double>(sample.count()) / iterationsPerSample);
+	}
+
+	return Summarize(samples, iterationsPerSample * samples.size());
+}
+
+BenchmarkStatistics TestBenchmark::Summarize(std::span<const double> nanosecondsPerIteration, uint64_t iterations)
+{
+	BenchmarkStatistics statistics;
+	statistics.Iterations = iterations;
+	statistics.Samples = static_cast<uint32_t>(nanosecondsPerIteration.size());
+	if (nanosecondsPerIteration.empty())
+		return statistics;
+
+	std::copy_n(nanosecondsPerIteration.begin(), statistics.Recorded().size(), statistics.PerIteration.begin());
+
+	std::vector<double> sorted(nanosecondsPerIteration.begin(), nanosecondsPerIteration.end());
+	std::sort(sorted.begin(), sorted.end());
+
+	double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+	double squares = 0.0;
+	for (double sample : sorted)
+		squares += (sample - mean) * (sample - mean);
+
+	using Duration = BenchmarkStatistics::Duration;
+	statistics.Mean = Duration(mean);
+	statistics.StdDev = Duration(sorted.size() > 1 ? std::sqrt(squares / (sorted.size() - 1)) : 0.0);
+	statistics.Min = Duration(sorted.front());
+	statistics.Max = Duration(sorted.back());
+	statistics.Median = Duration(Percentile(sorted, 0.5));
+	statistics.P90 = Duration(Percentile(sorted, 0.9));
+	statistics.P99 = Duration(Percentile(sorted, 0.99));
+	return statistics;
+}
+
+void TestBenchmark::Run(const std::function<void()>& body, const BenchmarkOptions& options)
+{
+	auto statistics = Measure(body, options);
+	if (const auto* context = CurrentTest())
+	{
+		TestMeasurements measurements;
+		if (auto measured = context->Result->Measurements())
+			measurements = *measured;
+		measurements.Benchmark = statistics;
+		context->Result->SetMeasurements(measurements);
+	}
+}
+
+}
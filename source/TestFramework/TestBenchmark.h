@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <type_traits>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace lsn::test_framework
+{
+	struct BenchmarkOptions
+	{
+		// run until this has passed before anything is measured, so caches, branch predictors and clocks settle
+		std::chrono::nanoseconds Warmup{ std::chrono::milliseconds(10) };
+		// roughly how long the measured samples take between them
+		std::chrono::nanoseconds TargetTime{ std::chrono::milliseconds(100) };
+		uint32_t MinSamples = 5;
+		uint32_t MaxSamples = 50; // at most BenchmarkStatistics::MaxRecordedSamples
+	};
+
+	// Timings are per iteration
+	struct BenchmarkStatistics
+	{
+		using Duration = std::chrono::duration<double, std::nano>;
+		static constexpr uint32_t MaxRecordedSamples = 64;
+
+		uint64_t Iterations = 0; // over every sample
+		uint32_t Samples = 0;
+
+		Duration Mean{ 0 };
+		Duration Median{ 0 };
+		Duration StdDev{ 0 };
+		Duration Min{ 0 };
+		Duration Max{ 0 };
+		Duration P90{ 0 };
+		Duration P99{ 0 };
+
+		// each sample's time per iteration in nanoseconds, in the order they were taken, for comparing runs
+		std::array<double, MaxRecordedSamples> PerIteration{};
+
+		std::span<const double> Recorded() const
+		{
+			return std::span<const double>(PerIteration.data(), std::min(Samples, MaxRecordedSamples));
+		}
+	};
+
+	static_assert(std::is_trivially_copyable_v<BenchmarkStatistics>);
+
+	// Keeps the compiler from discarding a value that's never used, or the work that produced it
+	template<typename T>
+	inline void DoNotOptimize(T&& value)
+	{
+#if defined __GNUC__ || defined __clang__
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+		_ReadWriteBarrier();
+#endif
+	}
+
+	// Keeps the compiler from assuming anything about memory, so pending writes have to be made
+	inline void ClobberMemory()
+	{
+#if defined __GNUC__ || defined __clang__
+		asm volatile("" : : : "memory");
+#else
+		_ReadWriteBarrier();
+#endif
+	}
+
+	struct TestBenchmark
+	{
+		// Warms the body up, then times it in samples of as many iterations as fit TargetTime / MaxSamples
+		static BenchmarkStatistics Measure(const std::function<void()>& body, const BenchmarkOptions& options = BenchmarkOptions());
+
+		// The statistics of each sample's time per iteration
+		static BenchmarkStatistics Summarize(std::span<const double> nanosecondsPerIteration, uint64_t iterations);
+
+		// Measures the body as the current test, its statistics are kept alongside the test's result
+		static void Run(const std::function<void()>& body, const BenchmarkOptions& options);
+	};
+}
@@ -0,0 +1,61 @@
+#include "TestCancellation.h"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace lsn::test_framework
+{
+
+namespace
+{
+	thread_local const TestContext* t_currentTest = nullptr;
+	thread_local std::stop_token t_currentToken;
+}
+
+const TestContext* CurrentTest()
+{
+	return t_currentTest;
+}
+
+std::stop_token CurrentStopToken()
+{
+	return t_currentToken;
+}
+
+bool IsCancellationRequested()
+{
+	return t_currentToken.stop_requested();
+}
+
+void CheckCancelled()
+{
+	if (t_currentToken.stop_requested())
+		throw test_cancelled();
+}
+
+void SleepFor(std::chrono::nanoseconds duration)
+{
+	// nothing is ever notified, the wait only ends early through the stop token
+	std::mutex mutex;
+	std::condition_variable_any sleeper;
+	std::unique_lock lock(mutex);
+	sleeper.wait_for(lock, t_currentToken, duration, []() { return false; });
+
+	CheckCancelled();
+}
+
+TestScope::TestScope(const TestContext& context, std::stop_token token)
+	: _previousContext(t_currentTest)
+	, _previousToken(std::move(t_currentToken))
+{
+	t_currentTest = &context;
+	t_currentToken = std::move(token);
+}
+
+TestScope::~TestScope()
+{
+	t_currentTest = _previousContext;
+	t_currentToken = std::move(_previousToken);
+}
+
+}
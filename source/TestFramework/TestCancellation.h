@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <stop_token>
+
+namespace lsn::test_framework
+{
+	struct TestContext;
+
+	// Thrown by CheckCancelled to unwind a test that has been cancelled or has run out of time
+	class test_cancelled
+	{
+	};
+
+	// The test running on this thread, or nullptr outside of a test
+	const TestContext* CurrentTest();
+
+	// Stops once the current test has been cancelled or exceeded its timeout.
+	// Outside of a test the token never stops.
+	std::stop_token CurrentStopToken();
+
+	bool IsCancellationRequested();
+
+	// Long running tests and helpers should call this regularly, so that they stop within moments of
+	// being cancelled rather than running on until the thread is forcibly killed.
+	void CheckCancelled();
+
+	// Sleeps for the duration, waking early and throwing test_cancelled if the test is cancelled
+	void SleepFor(std::chrono::nanoseconds duration);
+
+	// Makes a test current on this thread for as long as it's in scope
+	class TestScope
+	{
+	public:
+		TestScope(const TestContext& context, std::stop_token token);
+		~TestScope();
+
+		TestScope(const TestScope&) = delete;
+		TestScope& operator=(const TestScope&) = delete;
+
+	private:
+		const TestContext* _previousContext;
+		std::stop_token _previousToken;
+	};
+}
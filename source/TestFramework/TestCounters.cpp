@@ -0,0 +1,207 @@
+#include "TestCounters.h"
+
+#include <atomic>
+#include <memory>
+
+#if defined __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lsn::test_framework
+{
+
+#if defined __linux__
+
+namespace
+{
+	struct CounterEvent
+	{
+		uint32_t Type;
+		uint64_t Config;
+	};
+
+	constexpr uint64_t CacheReadMiss(uint64_t cache)
+	{
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+
+	// In TestCounter order, the hardware ones first so one of them leads the group
+	constexpr std::array<CounterEvent, TestCounterValues::Count> Events =
+	{ {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_L1D) },
+		{ PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_LL) },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+	} };
+
+	// Set once a thread couldn't open a single counter, the others won't fare any better
+	std::atomic<bool> s_unavailable{ false };
+
+	int OpenEvent(const CounterEvent& event, int group, bool excludeKernel)
+	{
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = event.Type;
+		attr.config = event.Config;
+		attr.exclude_kernel = excludeKernel;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// pid 0 and cpu -1 is the calling thread on whichever cpu it runs
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+	}
+
+	// The counters of one thread, read together as a group so they all cover the same stretch
+	struct CounterGroup
+	{
+		CounterGroup()
+		{
+			if (s_unavailable.load(std::memory_order_relaxed))
+				return;
+
+			for (size_t i = 0; i < Events.size(); ++i)
+			{
+				// Counting the kernel too is what's wanted, but a paranoid setting of 2 only allows user space.
+				// A context switch only ever happens in the kernel, so that has to be counted there or not at all.
+				bool software = Events[i].Type == PERF_TYPE_SOFTWARE;
+				int fd = OpenEvent(Events[i], _leader, false);
+				if (fd < 0 && !software && (errno == EACCES || errno == EPERM))
+					fd = OpenEvent(Events[i], _leader, true);
+				if (fd < 0)
+					continue;
+
+				if (_leader < 0)
+					_leader = fd;
+				_fds[i] = fd;
+				_order[_count++] = i;
+				_available |= 1u << i;
+			}
+
+			if (_leader < 0)
+			{
+				s_unavailable.store(true, std::memory_order_relaxed);
+				return;
+			}
+
+			ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+
+		~CounterGroup()
+		{
+			for (int fd : _fds)
+			{
+				if (fd >= 0)
+					close(fd);
+			}
+		}
+
+		CounterGroup(const CounterGroup&) = delete;
+		CounterGroup& operator=(const CounterGroup&) = delete;
+
+		std::optional<TestCounters::Sample> Read() const
+		{
+			if (_leader < 0)
+				return std::nullopt;
+
+			// { nr, time enabled, time running, a value per member in the order they joined }
+			uint64_t buffer[3 + TestCounterValues::Count]{};
+			auto size = (3 + _count) * sizeof(uint64_t);
+			if (read(_leader, buffer, size) != static_cast<ssize_t>(size) || buffer[0] != _count)
+				return std::nullopt;
+
+			TestCounters::Sample sample;
+			sample.TimeEnabled = buffer[1];
+			sample.TimeRunning = buffer[2];
+			sample.Available = _available;
+			for (size_t i = 0; i < _count; ++i)
+				sample.Values[_order[i]] = buffer[3 + i];
+			return sample;
+		}
+
+		uint32_t Available() const { return _available; }
+		pid_t Pid() const { return _pid; }
+
+	private:
+		pid_t _pid = getpid();
+		int _leader = -1;
+		std::array<int, TestCounterValues::Count> _fds = [] { std::array<int, TestCounterValues::Count> fds; fds.fill(-1); return fds; }();
+		std::array<size_t, TestCounterValues::Count> _order{};
+		size_t _count = 0;
+		uint32_t _available = 0;
+	};
+
+	// A forked worker inherits the group of the thread that forked it, which goes on counting that thread in the
+	// parent, so the child opens its own
+	CounterGroup& ThreadCounters()
+	{
+		thread_local std::unique_ptr<CounterGroup> group;
+		if (!group || group->Pid() != getpid())
+			group = std::make_unique<CounterGroup>();
+		return *group;
+	}
+}
+
+std::optional<TestCounters::Sample> TestCounters::Start()
+{
+	if (s_unavailable.load(std::memory_order_relaxed))
+		return std::nullopt;
+	return ThreadCounters().Read();
+}
+
+std::optional<TestCounterValues> TestCounters::Stop(const std::optional<Sample>& start)
+{
+	if (!start)
+		return std::nullopt;
+
+	auto end = ThreadCounters().Read();
+	if (!end)
+		return std::nullopt;
+
+	// the group only counts while it's on the pmu, when it's had to share it the counts are extrapolated
+	auto enabled = end->TimeEnabled - start->TimeEnabled;
+	auto running = end->TimeRunning - start->TimeRunning;
+	if (running == 0)
+		return std::nullopt;
+
+	double scale = static_cast<double>(enabled) / running;
+	TestCounterValues values;
+	values.Available = end->Available;
+	for (size_t i = 0; i < values.Values.size(); ++i)
+		values.Values[i] = static_cast<uint64_t>((end->Values[i] - start->Values[i]) * scale);
+	return values;
+}
+
+uint32_t TestCounters::Available()
+{
+	if (s_unavailable.load(std::memory_order_relaxed))
+		return 0;
+	return ThreadCounters().Available();
+}
+
+#else
+
+std::optional<TestCounters::Sample> TestCounters::Start()
+{
+	return std::nullopt;
+}
+
+std::optional<TestCounterValues> TestCounters::Stop(const std::optional<Sample>&)
+{
+	return std::nullopt;
+}
+
+uint32_t TestCounters::Available()
+{
+	return 0;
+}
+
+#endif
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+#include <XEnum.h>
+
+ImplementXEnum(TestCounter,
+	XValue(Cycles),
+	XValue(Instructions),
+	XValue(BranchMisses),
+	XValue(L1DMisses),
+	XValue(LLCMisses),
+	XValue(ContextSwitches)
+)
+
+// Hardware counters of the thread running a test, from perf_event_open on Linux. Whichever counters the
+// kernel won't open are left out, in a container or under a restrictive perf_event_paranoid that can be all
+// of them, when tests simply have no counters.
+namespace lsn::test_framework
+{
+	struct TestCounterValues
+	{
+		static constexpr size_t Count = XEnumTraits<TestCounter>::Count;
+
+		std::array<uint64_t, Count> Values{};
+		uint32_t Available = 0; // a bit per counter that was opened
+
+		bool IsAvailable(TestCounter counter) const { return (Available >> static_cast<size_t>(counter)) & 1; }
+		uint64_t operator[](TestCounter counter) const { return Values[static_cast<size_t>(counter)]; }
+	};
+
+	static_assert(std::is_trivially_copyable_v<TestCounterValues>);
+
+	struct TestCounters
+	{
+		// The raw counts of the calling thread at some point, along with how long they've been counting
+		struct Sample
+		{
+			std::array<uint64_t, TestCounterValues::Count> Values{};
+			uint64_t TimeEnabled = 0;
+			uint64_t TimeRunning = 0;
+			uint32_t Available = 0;
+		};
+
+		// The counters are opened on a thread's first call and left counting, so nested tests on the same
+		// thread each see their own difference. Nothing when no counter could be opened.
+		static std::optional<Sample> Start();
+
+		// The counts since start, scaled up should the kernel have had to multiplex the counters
+		static std::optional<TestCounterValues> Stop(const std::optional<Sample>& start);
+
+		// The counters that could be opened on the calling thread
+		static uint32_t Available();
+	};
+}
@@ -2,6 +2,10 @@
 
 #include <functional>
 #include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace lsn::test_framework
 {
@@ -13,8 +17,28 @@ namespace lsn::test_framework
 		Count,
 	};
 
+	// Something a test needs that only a limited number of tests can use at once, e.g. a port or a temp directory.
+	// Tests that use the same resource are never run together beyond its capacity, everything else is free to overlap.
+	struct TestResource
+	{
+		std::string Name;
+		int Capacity = 1; // how many tests can use it at once
+
+		bool operator==(const TestResource&) const = default;
+	};
+
 	struct TestObject;
 
+	// The instances Begin up to but not including End, of a test that stands for a source of them
+	struct InstanceRange
+	{
+		uint64_t Begin = 0;
+		uint64_t End = 0;
+
+		uint64_t Size() const { return End - Begin; }
+		bool operator==(const InstanceRange&) const = default;
+	};
+
 	struct TestDefinition
 	{
 		TestDefinition(const std::function<void()>& test)
@@ -30,6 +54,19 @@ namespace lsn::test_framework
 		const TestObject* _parent = nullptr;
 		TestConcurrency Concurrency = TestConcurrency::Any;
 		std::chrono::milliseconds Timeout{ 0 }; // default timeout
+		std::vector<TestResource> Resources;
+		std::optional<uint64_t> MaxAllocations; // fails the test should it allocate any more, when allocations are tracked
+		bool Explicit = false; // only run when asked for, by itself or a category it's in, never by RunAll
+
+		// Set on a test that stands for a whole source of a parameterized test's instances, which are only ever
+		// addressed by index so none of them are created up front. _test runs every one of them.
+		uint64_t NumInstances = 0;
+		std::function<void(uint64_t)> _instance;
+		std::function<std::string(uint64_t)> _describe; // an instance's name, only formatted once it's reported
+
+		// Dense index assigned once every test has been registered, used to find its result
+		static constexpr uint32_t Unindexed = ~0u;
+		uint32_t Index = Unindexed;
 	};
 }
 
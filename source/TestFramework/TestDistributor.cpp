@@ -0,0 +1,425 @@
+#include "TestDistributor.h"
+
+#include "TestRunner.h"
+#include "TestResult.h"
+#include "TestObject.h"
+#include "TestDefinition.h"
+#include "TestHistory.h"
+#include "TestForkServer.h"
+#include "TestResourceLocks.h"
+#include "TestRunState.h"
+#include "TestSocket.h"
+
+#include <format>
+#include <string>
+#include <algorithm>
+
+#if defined __linux__
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+namespace lsn::test_framework
+{
+
+#if defined __linux__
+
+using namespace socket_utils;
+
+namespace
+{
+	// worker -> coordinator
+	struct WorkerMessage
+	{
+		enum Kind : int32_t
+		{
+			RequestLease,
+			Result, // followed by the result of the test at the front of the lease
+		};
+
+		int32_t Type;
+	};
+
+	// coordinator -> worker, a lease of no tests tells the worker to exit
+	struct LeaseHeader
+	{
+		uint32_t Count;
+	};
+
+	// followed by the path of the test, which the worker finds in its own tree
+	struct LeasedTest
+	{
+		int64_t Timeout;
+		uint64_t Begin; // the range of its instances to run
+		uint64_t End;
+		uint32_t KeyLength;
+	};
+}
+
+struct TestDistributor::Session
+{
+	std::deque<TestContext*> Pending;
+	TestRunState& State;
+	TestResourceLocks& Resources;
+	const TestExecutionOptions& Options;
+
+	std::vector<std::unique_ptr<Worker>> Workers;
+	size_t NumWorkers = 0; // how many we aim to keep alive
+	int Wakeup[2] = { -1, -1 }; // interrupts the poll on cancellation, or once a test outside the session releases a resource
+};
+
+bool TestDistributor::IsSupported()
+{
+	return TestForkServer::IsRunning();
+}
+
+void TestDistributor::Run(std::span<TestContext* const> tests, TestRunState& state, TestResourceLocks& resources, const TestExecutionOptions& options, std::stop_token token)
+{
+	if (tests.empty())
+		return;
+
+	Session session{ { tests.begin(), tests.end() }, state, resources, options };
+	session.NumWorkers = std::clamp<size_t>(options.MaxNumberOfSimultaneousThreads, 1, tests.size());
+
+	if (pipe2(session.Wakeup, O_CLOEXEC | O_NONBLOCK) != 0)
+	{
+		for (auto* test : tests)
+			test->SetFailure("unable to create the coordinator's wake up pipe");
+		return;
+	}
+
+	auto wake = [fd = session.Wakeup[1]]()
+	{
+		char wake = 0;
+		(void)!write(fd, &wake, 1);
+	};
+
+	// the privileged tests run alongside us, pending tests may be waiting on what they hold
+	resources.OnReleased(wake);
+	std::stop_callback onCancel(token, wake);
+
+	auto stop = [](Worker& worker, int* exitStatus = nullptr)
+	{
+		kill(worker.Pid, SIGKILL);
+		int status = TestForkServer::Reap(worker.Pid);
+		close(worker.Socket);
+		if (exitStatus)
+			*exitStatus = status;
+	};
+
+	// An empty lease tells a worker with nothing left to run to exit, it hangs up once it has. One that doesn't
+	// within the grace period is killed like any other.
+	auto dismiss = [&stop, this](Worker& worker)
+	{
+		LeaseHeader none{ 0 };
+		if (!SendAll(worker.Socket, &none, sizeof(none)))
+			return stop(worker);
+
+		auto deadline = std::chrono::steady_clock::now() + DismissGracePeriod;
+		while (true)
+		{
+			auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			pollfd descriptor{ worker.Socket, POLLIN, 0 };
+			if (remaining.count() <= 0 || poll(&descriptor, 1, (int)remaining.count()) == 0)
+				return stop(worker);
+
+			// anything it still had to say, such as asking for another lease, is of no interest now
+			char drained[64];
+			auto numRead = read(worker.Socket, drained, sizeof(drained));
+			if (numRead == 0 || (numRead < 0 && errno != EINTR && errno != EAGAIN))
+				break;
+		}
+
+		TestForkServer::Reap(worker.Pid);
+		close(worker.Socket);
+		++_numDismissed;
+	};
+
+	size_t numSpawned = 0;
+	bool cancelled = false;
+	while (!cancelled)
+	{
+		// top up the workers, replacing any that were lost while there's still work for them
+		while (session.Workers.size() < session.NumWorkers && !session.Pending.empty())
+		{
+			auto worker = Spawn();
+			if (!worker)
+				break;
+
+			if (++numSpawned > session.NumWorkers)
+				++_numRespawned;
+			session.Workers.push_back(std::move(worker));
+		}
+
+		if (session.Workers.empty())
+		{
+			for (auto* test : session.Pending)
+				test->SetFailure("unable to fork a worker process");
+			break;
+		}
+
+		// hand out work to everyone waiting on it
+		for (auto& worker : session.Workers)
+		{
+			if (worker->Idle)
+				Grant(session, *worker);
+		}
+
+		bool leased = std::any_of(session.Workers.begin(), session.Workers.end(), [](const auto& worker) { return !worker->Lease.empty(); });
+		if (!leased && session.Pending.empty())
+			break;
+
+		// sleep until a worker has something to say, the earliest running test expires or we're cancelled
+		std::vector<pollfd> descriptors{ { session.Wakeup[0], POLLIN, 0 } };
+		auto deadline = std::chrono::steady_clock::time_point::max();
+		for (const auto& worker : session.Workers)
+		{
+			descriptors.push_back({ worker->Socket, POLLIN, 0 });
+			if (!worker->Lease.empty())
+				deadline = std::min(deadline, worker->Deadline);
+		}
+
+		int timeout = -1;
+		if (deadline != std::chrono::steady_clock::time_point::max())
+			timeout = (int)std::max<int64_t>(std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count(), 0);
+
+		if (poll(descriptors.data(), descriptors.size(), timeout) < 0 && errno != EINTR)
+			break;
+
+		if (descriptors[0].revents != 0)
+		{
+			char drained[64];
+			while (read(session.Wakeup[0], drained, sizeof(drained)) > 0) {}
+
+			if (token.stop_requested())
+			{
+				cancelled = true;
+				break;
+			}
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < session.Workers.size(); ++i)
+		{
+			auto& worker = *session.Workers[i];
+			bool lost = descriptors[i + 1].revents != 0 && !Receive(session, worker);
+			bool expired = !lost && !worker.Lease.empty() && now >= worker.Deadline;
+
+			// descriptors line up with the workers we polled, so the dead are only removed from the list at the end
+			if (lost || expired)
+			{
+				int status = 0;
+				stop(worker, &status);
+
+				if (expired)
+					Fail(session, worker, std::format("exceeded timeout duration of {}", worker.Lease.front()->DetermineTimeout(session.Options)));
+				else
+					Fail(session, worker, DescribeExit(status));
+
+				worker.Pid = -1;
+			}
+		}
+
+		std::erase_if(session.Workers, [](const auto& worker) { return worker->Pid < 0; });
+	}
+
+	// anyone left is either idle, about to ask for a lease, or running a test we no longer want
+	for (auto& worker : session.Workers)
+	{
+		if (!cancelled && worker->Lease.empty())
+		{
+			dismiss(*worker);
+			continue;
+		}
+
+		if (cancelled)
+			Fail(session, *worker, "cancelled");
+		stop(*worker);
+	}
+
+	resources.OnReleased(nullptr);
+	close(session.Wakeup[0]);
+	close(session.Wakeup[1]);
+}
+
+std::unique_ptr<TestDistributor::Worker> TestDistributor::Spawn()
+{
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+		return nullptr;
+
+	// the worker only gets its own end of its own socket
+	int pid = TestForkServer::Spawn(TestForkServer::Role::DistributedWorker, sockets[1]);
+	close(sockets[1]);
+	if (pid < 0)
+	{
+		close(sockets[0]);
+		return nullptr;
+	}
+
+	auto worker = std::make_unique<Worker>();
+	worker->Pid = pid;
+	worker->Socket = sockets[0];
+	return worker;
+}
+
+bool TestDistributor::Grant(Session& session, Worker& worker)
+{
+	// big leases while there's plenty left to keep the chatter down, single tests at the end to keep the tail even
+	size_t leaseSize = std::clamp<size_t>(session.Pending.size() / (2 * session.NumWorkers), 1, MaxLeaseSize);
+
+	// skip over anything whose resources are held by another lease, it'll be picked up once they're released.
+	// Those held by an abandoned test may never be, so what needs them is failed.
+	for (auto it = session.Pending.begin(); it != session.Pending.end() && worker.Lease.size() < leaseSize; )
+	{
+		if (session.Resources.TryAcquire(*(*it)->Definition))
+		{
+			worker.Lease.push_back(*it);
+			it = session.Pending.erase(it);
+		}
+		else if (session.Resources.Strand(**it))
+		{
+			it = session.Pending.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	if (worker.Lease.empty())
+		return false;
+
+	std::string message;
+	LeaseHeader header{ (uint32_t)worker.Lease.size() };
+	message.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const auto* test : worker.Lease)
+	{
+		auto key = TestHistory::KeyOf(*test->Definition->_parent);
+		LeasedTest leased{ test->DetermineTimeout(session.Options).count(), test->Instances.Begin, test->Instances.End, (uint32_t)key.size() };
+		message.append(reinterpret_cast<const char*>(&leased), sizeof(leased));
+		message += key;
+	}
+
+	worker.Idle = false;
+	++_numLeases;
+	Start(session, worker);
+
+	// should the worker have died, we'll find out when its socket hangs up
+	SendAll(worker.Socket, message.data(), message.size());
+	return true;
+}
+
+void TestDistributor::Start(Session& session, Worker& worker)
+{
+	auto* test = worker.Lease.front();
+	session.State.Start(*test->Definition);
+	test->Result->Reset();
+	test->Result->Begin(std::chrono::high_resolution_clock::now().time_since_epoch());
+	worker.Deadline = std::chrono::steady_clock::now() + test->DetermineTimeout(session.Options);
+}
+
+bool TestDistributor::Receive(Session& session, Worker& worker)
+{
+	WorkerMessage message{};
+	if (!ReceiveAll(worker.Socket, &message, sizeof(message)))
+		return false;
+
+	if (message.Type == WorkerMessage::RequestLease)
+	{
+		worker.Idle = true;
+		return worker.Lease.empty();
+	}
+
+	if (message.Type != WorkerMessage::Result || worker.Lease.empty())
+		return false;
+
+	auto* test = worker.Lease.front();
+	if (!ReceiveResult(worker.Socket, *test->Result))
+		return false;
+
+	worker.Lease.pop_front();
+	session.Resources.Release(*test->Definition);
+	session.State.Finish(*test->Definition, *test->Result, test->Instances);
+
+	if (!worker.Lease.empty())
+		Start(session, worker);
+	return true;
+}
+
+void TestDistributor::Fail(Session& session, Worker& worker, const std::string& reason)
+{
+	if (worker.Lease.empty())
+		return;
+
+	auto* test = worker.Lease.front();
+	test->SetFailure(reason);
+	session.Resources.Release(*test->Definition);
+	session.State.Finish(*test->Definition, *test->Result, test->Instances);
+	worker.Lease.pop_front();
+
+	// the rest of the lease never started, so it goes back to the front of the queue in the same order
+	_numRequeued += worker.Lease.size();
+	for (auto it = worker.Lease.rbegin(); it != worker.Lease.rend(); ++it)
+	{
+		session.Resources.Release(*(*it)->Definition);
+		session.Pending.push_front(*it);
+	}
+	worker.Lease.clear();
+}
+
+void TestDistributor::Serve(int socket)
+{
+	while (true)
+	{
+		WorkerMessage request{ WorkerMessage::RequestLease };
+		LeaseHeader header{};
+		if (!SendAll(socket, &request, sizeof(request)) || !ReceiveAll(socket, &header, sizeof(header)) || header.Count == 0)
+			_exit(0);
+
+		std::vector<std::pair<LeasedTest, std::string>> lease(header.Count);
+		for (auto& [leased, key] : lease)
+		{
+			if (!ReceiveAll(socket, &leased, sizeof(leased)))
+				_exit(0);
+
+			key.resize(leased.KeyLength);
+			if (!ReceiveAll(socket, key.data(), key.size()))
+				_exit(0);
+		}
+
+		for (const auto& [leased, key] : lease)
+		{
+			TestResult result;
+			TestForkServer::Run(key, { leased.Begin, leased.End }, std::chrono::milliseconds(leased.Timeout), result);
+
+			WorkerMessage message{ WorkerMessage::Result };
+			if (!SendAll(socket, &message, sizeof(message)) || !SendResult(socket, result))
+				_exit(0);
+		}
+	}
+}
+
+#else
+
+bool TestDistributor::IsSupported()
+{
+	return false;
+}
+
+void TestDistributor::Run(std::span<TestContext* const> tests, TestRunState& state, TestResourceLocks& resources, const TestExecutionOptions& options, std::stop_token token)
+{
+	for (auto* test : tests)
+	{
+		test->Result->Reset();
+		test->SetFailure("distributed runs are not supported on this platform");
+	}
+}
+
+#endif
+
+}
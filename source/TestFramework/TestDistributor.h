@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <span>
+#include <string>
+#include <stop_token>
+#include <vector>
+
+namespace lsn::test_framework
+{
+	struct TestContext;
+	struct TestExecutionOptions;
+	class TestResourceLocks;
+	class TestRunState;
+
+	// Runs a session across worker processes forked by the TestForkServer, with this process acting as the coordinator.
+	// Workers ask for a lease of tests whenever they run dry, so the faster ones naturally take on more of
+	// the suite. Results are streamed back a test at a time into the coordinator's results, and should a
+	// worker crash or hang, the test it was on fails and the rest of its lease goes back on the queue.
+	struct TestDistributor
+	{
+		static bool IsSupported();
+
+		// The most tests handed out in one lease, leases shrink as the queue drains so the tail stays balanced
+		static constexpr size_t MaxLeaseSize = 16;
+		// How long a worker told to exit has to do so before it's killed
+		static constexpr std::chrono::milliseconds DismissGracePeriod{ 1000 };
+
+		TestDistributor() = default;
+		TestDistributor(const TestDistributor&) = delete;
+
+		// Blocks until every test has run or we're cancelled
+		void Run(std::span<TestContext* const> tests, TestRunState& state, TestResourceLocks& resources, const TestExecutionOptions& options, std::stop_token token);
+
+		size_t NumLeases() const { return _numLeases; }
+		size_t NumRequeued() const { return _numRequeued; }
+		size_t NumRespawned() const { return _numRespawned; }
+		// workers that exited when told to at the end of a session, rather than being killed
+		size_t NumDismissed() const { return _numDismissed; }
+
+	private:
+		struct Worker
+		{
+			int Pid = -1;
+			int Socket = -1;
+			bool Idle = false; // waiting on a lease
+
+			std::deque<TestContext*> Lease; // in the order they'll be run, the front is running
+			std::chrono::steady_clock::time_point Deadline;
+		};
+
+		struct Session;
+
+		std::unique_ptr<Worker> Spawn();
+		bool Grant(Session& session, Worker& worker);
+		void Start(Session& session, Worker& worker);
+		bool Receive(Session& session, Worker& worker);
+		// Fails the running test and puts the rest of the lease back on the queue
+		void Fail(Session& session, Worker& worker, const std::string& reason);
+
+		// The loop a forked worker runs until it's told to exit
+		friend struct TestForkServer;
+		[[noreturn]] static void Serve(int socket);
+
+		size_t _numLeases = 0;
+		size_t _numRequeued = 0;
+		size_t _numRespawned = 0;
+		size_t _numDismissed = 0;
+	};
+}
@@ -0,0 +1,192 @@
+#include "TestExecutor.h"
+
+#include <algorithm>
+
+#if defined _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <processthreadsapi.h>
+#endif
+
+namespace lsn::thread_utils
+{
+	bool KillThread(std::thread& thread)
+	{
+		if (!thread.joinable())
+			return false;
+
+#if defined _WIN32
+		if (!TerminateThread(thread.native_handle(), 0))
+			return false;
+
+		thread.detach();
+		return true;
+#else
+		// Nothing can stop a thread from outside here. A hung test is abandoned instead, or is run in a worker
+		// process that can be killed, see TestIsolation::Process.
+		return false;
+#endif
+	}
+}
+
+namespace lsn::test_framework
+{
+
+TestExecutor::~TestExecutor()
+{
+	std::vector<std::shared_ptr<Worker>> workers;
+	{
+		std::lock_guard lock(_state->Mutex);
+		_state->Shutdown = true;
+		workers.swap(_state->Workers);
+
+		// anything still running at this point has hung, so it's abandoned rather than waited on
+		for (auto& worker : workers)
+			worker->Abandoned = worker->Current != nullptr;
+	}
+	_state->WorkAvailable.notify_all();
+
+	for (auto& worker : workers)
+	{
+		if (!worker->Abandoned)
+			worker->Thread.join();
+		else if (!lsn::thread_utils::KillThread(worker->Thread))
+			worker->Thread.detach();
+	}
+}
+
+TestExecutor::JobHandle TestExecutor::Execute(std::function<void()> work)
+{
+	auto job = std::make_shared<Job>();
+	job->Work = std::move(work);
+
+	{
+		std::lock_guard lock(_state->Mutex);
+		_state->Queue.push_back(job);
+
+		// only grow the pool when every existing worker is busy
+		if (_state->NumIdle < _state->Queue.size())
+		{
+			auto worker = std::make_shared<Worker>();
+			worker->Thread = std::thread(&TestExecutor::Process, _state, worker);
+			_state->Workers.push_back(std::move(worker));
+		}
+	}
+
+	_state->WorkAvailable.notify_one();
+	return job;
+}
+
+bool TestExecutor::Abandon(const JobHandle& job)
+{
+	std::shared_ptr<Worker> worker;
+	{
+		std::lock_guard lock(_state->Mutex);
+
+		// still queued, nobody has picked it up yet
+		auto& queue = _state->Queue;
+		if (auto iter = std::find(queue.begin(), queue.end(), job); iter != queue.end())
+		{
+			queue.erase(iter);
+			return true;
+		}
+
+		auto& workers = _state->Workers;
+		auto iter = std::find_if(workers.begin(), workers.end(), [&](const auto& w) { return w->Current == job; });
+		if (iter == workers.end())
+			return true; // already finished
+
+		worker = *iter;
+		worker->Abandoned = true;
+		workers.erase(iter);
+	}
+
+	if (lsn::thread_utils::KillThread(worker->Thread))
+		return true;
+
+	// the worker will exit by itself if the job ever returns
+	worker->Thread.detach();
+	return false;
+}
+
+size_t TestExecutor::NumWorkers() const
+{
+	std::lock_guard lock(_state->Mutex);
+	return _state->Workers.size();
+}
+
+void TestExecutor::Process(std::shared_ptr<State> state, std::shared_ptr<Worker> worker)
+{
+	std::unique_lock lock(state->Mutex);
+	while (true)
+	{
+		++state->NumIdle;
+		state->WorkAvailable.wait(lock, [&]() { return state->Shutdown || !state->Queue.empty(); });
+		--state->NumIdle;
+
+		if (state->Shutdown)
+			return;
+
+		auto job = std::move(state->Queue.front());
+		state->Queue.pop_front();
+		worker->Current = job;
+
+		lock.unlock();
+		std::invoke(job->Work);
+		job->Finish();
+		lock.lock();
+
+		worker->Current = nullptr;
+		if (worker->Abandoned)
+			return;
+	}
+}
+
+//===========================================================================================================
+namespace
+{
+	TestExecutor& HelperExecutor()
+	{
+		static TestExecutor executor;
+		return executor;
+	}
+
+	std::atomic<size_t>& FreeHelpers()
+	{
+		static std::atomic<size_t> free = TestHelpers::Capacity();
+		return free;
+	}
+}
+
+size_t TestHelpers::Capacity()
+{
+	return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+std::vector<TestExecutor::JobHandle> TestHelpers::Borrow(size_t count, const std::function<void()>& work)
+{
+	std::vector<TestExecutor::JobHandle> helpers;
+	auto& free = FreeHelpers();
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto available = free.load();
+		do
+		{
+			if (available == 0)
+				return helpers;
+		} while (!free.compare_exchange_weak(available, available - 1));
+
+		auto job = HelperExecutor().Execute(work);
+		job->Then([&free]() { ++free; });
+		helpers.push_back(std::move(job));
+	}
+	return helpers;
+}
+
+void TestHelpers::Wait(const std::vector<TestExecutor::JobHandle>& helpers)
+{
+	for (const auto& helper : helpers)
+		helper->Wait();
+}
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace lsn::thread_utils
+{
+	// Forcibly stops a thread, returns false if the platform does not support it, which only Windows does.
+	// Elsewhere a test that has to be killed is run in a worker process.
+	bool KillThread(std::thread& thread);
+}
+
+namespace lsn::test_framework
+{
+	// Long lived pool of worker threads owned by the TestRunner.
+	// Threads are created on demand and reused across tests and sessions,
+	// only a worker that has been abandoned (ie. a test that timed out) is ever replaced.
+	struct TestExecutor
+	{
+		struct Job
+		{
+			// Raised on the job by whoever is interested in waking the waiter
+			enum Event : uint32_t
+			{
+				Finished = 1 << 0,
+				Expired = 1 << 1,
+				Cancelled = 1 << 2,
+				Overdue = 1 << 3, // a job asked to stop has had long enough to do so
+			};
+
+			std::function<void()> Work;
+			std::atomic<uint32_t> Events{ 0 };
+
+			bool Has(Event e) const { return (Events.load() & e) != 0; }
+
+			void Notify(Event e)
+			{
+				Events.fetch_or(e);
+				Events.notify_all();
+			}
+
+			// Blocks until any event has been raised
+			uint32_t WaitForAny() const
+			{
+				Events.wait(0);
+				return Events.load();
+			}
+
+			// Blocks until any of the given events has been raised
+			uint32_t WaitFor(uint32_t events) const
+			{
+				auto raised = Events.load();
+				for (; (raised & events) == 0; raised = Events.load())
+					Events.wait(raised);
+				return raised;
+			}
+
+			// Blocks until the work has actually returned
+			void Wait() const
+			{
+				WaitFor(Finished);
+			}
+
+			// Calls the continuation once the work has returned, straight away if it already has.
+			// For whatever has to outlive a job that was abandoned while still running.
+			void Then(std::function<void()> continuation)
+			{
+				{
+					std::lock_guard lock(_mutex);
+					if (!Has(Finished))
+					{
+						_continuations.push_back(std::move(continuation));
+						return;
+					}
+				}
+				std::invoke(continuation);
+			}
+
+			// Raised by the worker once the work has returned
+			void Finish()
+			{
+				std::vector<std::function<void()>> continuations;
+				{
+					std::lock_guard lock(_mutex);
+					Notify(Finished);
+					continuations.swap(_continuations);
+				}
+
+				for (auto& continuation : continuations)
+					std::invoke(continuation);
+			}
+
+		private:
+			std::mutex _mutex;
+			std::vector<std::function<void()>> _continuations;
+		};
+
+		using JobHandle = std::shared_ptr<Job>;
+
+		TestExecutor() = default;
+		TestExecutor(const TestExecutor&) = delete;
+		~TestExecutor();
+
+		JobHandle Execute(std::function<void()> work);
+
+		// Stops the worker executing the job and retires it from the pool.
+		// Returns false if the job could not be forcibly stopped, in which case the worker is left to finish on its own.
+		bool Abandon(const JobHandle& job);
+
+		size_t NumWorkers() const;
+
+	private:
+		struct Worker
+		{
+			std::thread Thread;
+			JobHandle Current;
+			bool Abandoned = false;
+		};
+
+		// Shared with the workers so that a detached worker can outlive the executor
+		struct State
+		{
+			std::mutex Mutex;
+			std::condition_variable WorkAvailable;
+			std::deque<JobHandle> Queue;
+			std::vector<std::shared_ptr<Worker>> Workers;
+			size_t NumIdle = 0;
+			bool Shutdown = false;
+		};
+
+		static void Process(std::shared_ptr<State> state, std::shared_ptr<Worker> worker);
+
+		std::shared_ptr<State> _state = std::make_shared<State>();
+	};
+
+	// Workers for a test to spread its own work across, e.g. shrinking a property or fuzzing. Shared by every test
+	// and bounded to one fewer than there are cores between them, so a test only gets the helpers that are free
+	// and always does its share of the work itself.
+	struct TestHelpers
+	{
+		static size_t Capacity();
+
+		// Starts the work on up to count helpers, as many as are free. Wait on all of them before anything the
+		// work refers to goes away.
+		static std::vector<TestExecutor::JobHandle> Borrow(size_t count, const std::function<void()>& work);
+		static void Wait(const std::vector<TestExecutor::JobHandle>& helpers);
+	};
+}
@@ -0,0 +1,238 @@
+#include "TestForkServer.h"
+
+#include "TestRunner.h"
+#include "TestResult.h"
+#include "TestObject.h"
+#include "TestDefinition.h"
+#include "TestRegistration.h"
+#include "TestProcessPool.h"
+#include "TestDistributor.h"
+#include "TestSocket.h"
+
+#include <cstdlib>
+#include <deque>
+#include <format>
+#include <mutex>
+
+#if defined __linux__
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#endif
+
+namespace lsn::test_framework
+{
+
+namespace
+{
+	// Built by the server before it forks anything, so every worker starts with the same tree
+	std::deque<TestObject>& Tree()
+	{
+		static std::deque<TestObject> tree;
+		return tree;
+	}
+}
+
+#if defined __linux__
+
+using namespace socket_utils;
+
+namespace
+{
+	struct ServerRequest
+	{
+		enum Kind : int32_t
+		{
+			Spawn, // carries the socket the new process should serve
+			Reap,
+		};
+
+		int32_t Type;
+		int32_t Role;
+		int32_t Pid;
+	};
+
+	int s_control = -1; // our end of the server's socket
+	std::mutex s_mutex; // requests to the server are serialized, it only ever forks or reaps
+	bool s_isWorker = false;
+
+	// Parents first, as they would be for any test. One that fails is left to the tests that need it to try again,
+	// and fail with.
+	void Initialize(const TestObject& object)
+	{
+		try
+		{
+			TestRunner::Initialize(object);
+		}
+		catch (...)
+		{
+			return;
+		}
+
+		for (const auto& child : object.Children)
+			Initialize(*child);
+	}
+}
+
+void TestForkServer::Serve(Role role, int socket)
+{
+	switch (role)
+	{
+	case Role::Worker:
+		TestProcessPool::Serve(socket);
+	case Role::Zygote:
+		for (const auto& category : Tree())
+			Initialize(category);
+		TestProcessPool::ServeZygote(socket);
+	case Role::DistributedWorker:
+		TestDistributor::Serve(socket);
+	}
+	_exit(1);
+}
+
+void TestForkServer::ServeServer(int control)
+{
+	BuildTestTree(RegisteredCategories(), RegisteredTests(), Tree());
+
+	while (true)
+	{
+		ServerRequest request;
+		int descriptor = -1;
+		if (!ReceiveWithDescriptor(control, &request, sizeof(request), descriptor))
+			_exit(0);
+
+		int32_t reply = -1;
+		if (request.Type == ServerRequest::Spawn && descriptor >= 0)
+		{
+			pid_t pid = fork();
+			if (pid == 0)
+			{
+				// take the worker down with us, we go when the process that started us does
+				prctl(PR_SET_PDEATHSIG, SIGKILL);
+				close(control);
+				Serve(static_cast<Role>(request.Role), descriptor);
+			}
+
+			close(descriptor);
+			reply = pid;
+		}
+		else if (request.Type == ServerRequest::Reap)
+		{
+			int status = 0;
+			while (waitpid(request.Pid, &status, 0) < 0 && errno == EINTR) {}
+			reply = status;
+		}
+
+		if (!SendAll(control, &reply, sizeof(reply)))
+			_exit(0);
+	}
+}
+
+bool TestForkServer::Start()
+{
+	if (s_control >= 0)
+		return true;
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+		return false;
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+		close(sockets[0]);
+		s_isWorker = true;
+		ServeServer(sockets[1]);
+	}
+
+	close(sockets[1]);
+	if (pid < 0)
+	{
+		close(sockets[0]);
+		return false;
+	}
+
+	s_control = sockets[0];
+	return true;
+}
+
+bool TestForkServer::IsRunning()
+{
+	return s_control >= 0;
+}
+
+bool TestForkServer::IsWorker()
+{
+	return s_isWorker;
+}
+
+int TestForkServer::Spawn(Role role, int socket)
+{
+	if (s_control < 0)
+		return -1;
+
+	std::lock_guard lock(s_mutex);
+	ServerRequest request{ ServerRequest::Spawn, static_cast<int32_t>(role), 0 };
+	int32_t pid = -1;
+	if (!SendWithDescriptor(s_control, &request, sizeof(request), socket) || !ReceiveAll(s_control, &pid, sizeof(pid)))
+		return -1;
+	return pid;
+}
+
+int TestForkServer::Reap(int pid)
+{
+	if (s_control < 0)
+		return 0;
+
+	std::lock_guard lock(s_mutex);
+	ServerRequest request{ ServerRequest::Reap, 0, pid };
+	int32_t status = 0;
+	if (SendAll(s_control, &request, sizeof(request)))
+		ReceiveAll(s_control, &status, sizeof(status));
+	return status;
+}
+
+#else
+
+bool TestForkServer::Start() { return false; }
+bool TestForkServer::IsRunning() { return false; }
+bool TestForkServer::IsWorker() { return false; }
+int TestForkServer::Spawn(Role role, int socket) { return -1; }
+int TestForkServer::Reap(int pid) { return 0; }
+void TestForkServer::Serve(Role role, int socket) { std::abort(); }
+void TestForkServer::ServeServer(int control) { std::abort(); }
+
+#endif
+
+const TestDefinition* TestForkServer::Find(const std::string& key)
+{
+	auto* object = FindTest(Tree(), key);
+	return object ? object->Definition.get() : nullptr;
+}
+
+void TestForkServer::Run(const std::string& key, InstanceRange instances, std::chrono::milliseconds timeout, TestResult& result)
+{
+	TestContext context{ Find(key), &result };
+	if (!context.Definition)
+	{
+		auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
+		result.Begin(now);
+		result.SetFailure(test_failure(std::format("{} isn't a registered test, only those can be run in a worker process", key), "", 0));
+		result.End(now);
+		return;
+	}
+
+	// the range is the coordinator's, should its tree not match ours only what we have is run
+	instances.End = std::min(instances.End, context.Definition->NumInstances);
+	context.Instances = { std::min(instances.Begin, instances.End), instances.End };
+
+	TestExecutionOptions options;
+	options.DefaultTimeOut = timeout;
+	options.MaximumTimeout = options.DefaultTimeOut;
+	TestRunner::RunInternal(context, options);
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "TestDefinition.h"
+
+namespace lsn::test_framework
+{
+	struct TestResult;
+
+	// A process forked first thing in main, before anything has started a thread, which forks every worker process
+	// from then on. Forking while other threads run only brings the forking thread along, and whatever the others
+	// had locked, the allocator included, stays locked in the child. Nor should a worker start from whatever the
+	// tests have done to this process so far.
+	// The server never runs a test. It builds a tree of the registered tests of its own, which the workers inherit
+	// and find their tests in by path, so only registered tests can be run in a worker.
+	struct TestForkServer
+	{
+		enum class Role : int32_t
+		{
+			Worker, // runs the tests a TestProcessPool sends it
+			Zygote, // runs every initializer, then forks a worker per test
+			DistributedWorker, // leases tests from a TestDistributor
+		};
+
+		// Call before anything starts a thread, false where there's no fork or it failed.
+		// Worker processes are only supported once it's running.
+		static bool Start();
+		static bool IsRunning();
+
+		// Whether this process was forked from the server, as every worker is
+		static bool IsWorker();
+
+		// Forks a process serving the socket in the role, the pid or -1. The caller still closes its own copy.
+		static int Spawn(Role role, int socket);
+
+		// Waits for a process the server forked to exit once it's been killed, the status waitpid gave
+		static int Reap(int pid);
+
+		// In a worker, the test at the path TestHistory::KeyOf gives, creating the instances of a parameterized
+		// test on the way. Null when it isn't a registered test.
+		static const TestDefinition* Find(const std::string& key);
+
+		// In a worker, runs those of the instances of the test at the path that it has, failing it when it isn't
+		// a registered test. A test without instances is given an empty range.
+		static void Run(const std::string& key, InstanceRange instances, std::chrono::milliseconds timeout, TestResult& result);
+
+	private:
+		// Forks and reaps what it's asked to until the process that started it goes
+		[[noreturn]] static void ServeServer(int control);
+
+		// What a process the server forks does from then on
+		[[noreturn]] static void Serve(Role role, int socket);
+	};
+}
@@ -11,10 +11,22 @@
 #include <tuple>
 #include <type_traits>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <ranges>
+#include <sstream>
+#include <thread>
 
 #include "TestDefinition.h"
 #include "TestResult.h" // needed for test_failure
+#include "TestCancellation.h"
+#include "TestExecutor.h"
 #include "TestManager.h"
+#include "TestRegistration.h"
+#include "TestValues.h"
+#include "TestProperty.h"
+#include "TestFuzzer.h"
+#include "TestBenchmark.h"
 
 
 #define GenerateTestDeclarationName(test_name) test_name ## _test_definition
@@ -41,40 +53,108 @@ namespace lsn::test_framework::details
 #define ImplementTestArguments_Arguments(...) __VA_ARGS__
 #define ImplementTestArguments_WithConcurrency(...)
 #define ImplementTestArguments_Timeout(...)
+#define ImplementTestArguments_Uses(...)
+#define ImplementTestArguments_Combine(...)
+#define ImplementTestArguments_Zip(...)
+#define ImplementTestArguments_ForAll(...)
+#define ImplementTestArguments_Trials(...)
+#define ImplementTestArguments_Benchmark(...)
+#define ImplementTestArguments_Warmup(...)
+#define ImplementTestArguments_TargetTime(...)
+#define ImplementTestArguments_MaxAllocations(...)
+#define ImplementTestArguments_Explicit(...)
 
 #define ImplementTestDataSource_ValueSource(...) .AddTestsFromSource( []() { return __VA_ARGS__ ();} )
 #define ImplementTestDataSource_ValueCase(...) .AddTestsFromValues(__VA_ARGS__)
 #define ImplementTestDataSource_Arguments(...)
 #define ImplementTestDataSource_WithConcurrency(...)
 #define ImplementTestDataSource_Timeout(...)
+#define ImplementTestDataSource_Uses(...)
+#define ImplementTestDataSource_Combine(...) .AddTestsFromIndexed( []() { using namespace lsn::test_framework::values; return Combine(__VA_ARGS__); } )
+#define ImplementTestDataSource_Zip(...) .AddTestsFromIndexed( []() { using namespace lsn::test_framework::values; return Zip(__VA_ARGS__); } )
+#define ImplementTestDataSource_ForAll(...) .AddTestsFromProperty( []() { using namespace lsn::test_framework::properties; return ForAll(__VA_ARGS__); } )
+#define ImplementTestDataSource_Trials(...)
+#define ImplementTestDataSource_Benchmark(...)
+#define ImplementTestDataSource_Warmup(...)
+#define ImplementTestDataSource_TargetTime(...)
+#define ImplementTestDataSource_MaxAllocations(...)
+#define ImplementTestDataSource_Explicit(...)
 
 #define ImplementTestRequirements_ValueSource(...)
 #define ImplementTestRequirements_ValueCase(...)
 #define ImplementTestRequirements_Arguments(...)
 #define ImplementTestRequirements_WithConcurrency(...) .SetRequirement(__VA_ARGS__)
 #define ImplementTestRequirements_Timeout(...) .SetTimeout(__VA_ARGS__)
-
-
+#define ImplementTestRequirements_Uses(...) .Uses(__VA_ARGS__)
+#define ImplementTestRequirements_Combine(...)
+#define ImplementTestRequirements_Zip(...)
+#define ImplementTestRequirements_ForAll(...)
+#define ImplementTestRequirements_Trials(...) .SetTrials(__VA_ARGS__)
+#define ImplementTestRequirements_Benchmark(...) .AsBenchmark()
+#define ImplementTestRequirements_Warmup(...) .SetWarmup(__VA_ARGS__)
+#define ImplementTestRequirements_TargetTime(...) .SetTargetTime(__VA_ARGS__)
+#define ImplementTestRequirements_MaxAllocations(...) .SetMaxAllocations(__VA_ARGS__)
+#define ImplementTestRequirements_Explicit(...) .SetExplicit()
+
+
+// The generator only runs once the tree is first built, until then a test is a constant record and a pointer to it
 #define DeclareTest_Internal(category, test_name, ...) void test_name (FOR_EACH_MACRO(ImplementTestArguments_, __VA_ARGS__)); \
-static volatile const auto* GenerateTestDeclarationName(test_name) = category->Add(lsn::test_framework::TestGenerator<decltype(test_name)>(&test_name, #test_name, __FILE__, __LINE__) \
-FOR_EACH_MACRO(ImplementTestDataSource_, __VA_ARGS__) \
-FOR_EACH_MACRO(ImplementTestRequirements_, __VA_ARGS__) \
-.Generate()); \
+static constexpr lsn::test_framework::TestRegistration GenerateTestDeclarationName(test_name){ &category, __FILE__, __LINE__, []() \
+{ \
+	return lsn::test_framework::TestGenerator<decltype(test_name)>(&test_name, #test_name, __FILE__, __LINE__) \
+	FOR_EACH_MACRO(ImplementTestDataSource_, __VA_ARGS__) \
+	FOR_EACH_MACRO(ImplementTestRequirements_, __VA_ARGS__) \
+	.Generate(); \
+} }; \
+RegisterTest(test_name ## _registration, GenerateTestDeclarationName(test_name)) \
 inline static void test_name (FOR_EACH_MACRO(ImplementTestArguments_, __VA_ARGS__)) 
 
-#define DeclareTestSubCategory(parent, name) namespace name {lsn::test_framework::TestObject* Category = parent::Category->Add(#name); } namespace name
-#define DeclareTestCategory(name) namespace name { TestObject* Category = lsn::test_framework::TestManager::Instance().Add(#name); } namespace name
+#define DeclareTestSubCategory(parent, name) namespace name { inline constexpr lsn::test_framework::TestCategoryRegistration Category{ #name, &parent::Category, __FILE__, __LINE__ }; RegisterTestCategory(Category_registration, Category) } namespace name
+#define DeclareTestCategory(name) namespace name { inline constexpr lsn::test_framework::TestCategoryRegistration Category{ #name, nullptr, __FILE__, __LINE__ }; RegisterTestCategory(Category_registration, Category) } namespace name
 #define DeclareTest(...) DeclareTest_Internal( Category, __VA_ARGS__)
+// A test of randomly generated arguments, declared with ForAll(generators...) and optionally Trials(n)
+#define DeclareProperty(...) DeclareTest_Internal( Category, __VA_ARGS__)
+// A test whose body is timed over many iterations, optionally with Warmup(duration) and TargetTime(duration).
+// Benchmarks are exclusive so nothing else running skews them.
+#define DeclareBenchmark(test_name, ...) DeclareTest_Internal( Category, test_name, Benchmark() __VA_OPT__(,) __VA_ARGS__)
+// Set up shared by every test in the category, run once in a process before the first of them. The zygote runs
+// them all before it forks, so none of the tests it forks pay for them.
+#define DeclareTestInitializer() static void TestInitializer(); \
+static constexpr lsn::test_framework::TestRegistration TestInitializer_definition{ &Category, __FILE__, __LINE__, nullptr, &TestInitializer }; \
+RegisterTest(TestInitializer_registration, TestInitializer_definition) \
+static void TestInitializer()
 
 namespace lsn::test_framework
 {
 	namespace tuple_utils
 	{
+		// anything that can't be streamed itself but is a range, e.g. the vectors of a property, is written as [a, b, c]
+		template<class T>
+		void print(std::ostream& s, const T& value)
+		{
+			if constexpr (requires { s << value; })
+			{
+				s << value;
+			}
+			else if constexpr (std::ranges::range<T>)
+			{
+				s << '[';
+				bool first = true;
+				for (const auto& element : value)
+				{
+					s << (first ? "" : ", ");
+					print(s, element);
+					first = false;
+				}
+				s << ']';
+			}
+		}
+
 		template<class TupType, size_t... I>
 		std::string to_string(const TupType& _tup, std::index_sequence<I...>)
 		{
 			std::stringstream s;
-			(..., (s << (I == 0 ? "" : ", ") << std::get<I>(_tup)));
+			(..., (s << (I == 0 ? "" : ", "), print(s, std::get<I>(_tup))));
 			return s.str();
 		}
 
@@ -85,6 +165,122 @@ namespace lsn::test_framework
 		}
 	}
 
+	namespace properties
+	{
+		namespace details
+		{
+			// The failure of one set of arguments, if they fail
+			template<typename Arguments>
+			std::optional<test_failure> Evaluate(const std::function<void(const Arguments&)>& test, const Arguments& arguments, const std::string& file, int lineNumber)
+			{
+				try
+				{
+					test(arguments);
+					return std::nullopt;
+				}
+				catch (const test_failure& failure)
+				{
+					return failure;
+				}
+				catch (const test_cancelled&)
+				{
+					throw;
+				}
+				catch (const std::exception& unexpected_failure)
+				{
+					return test_failure(unexpected_failure.what(), file, lineNumber);
+				}
+				catch (...)
+				{
+					return test_failure("uknown exception encountered", file, lineNumber);
+				}
+			}
+
+			// The first of the candidates that still fails, tried on whichever shared helpers are free alongside this
+			// thread. The lowest failing one is always found, as a candidate is only skipped once one before it has
+			// failed, so shrinking is the same on every run however many helpers it got.
+			template<typename Arguments>
+			std::optional<std::pair<size_t, test_failure>> FirstFailing(const std::function<void(const Arguments&)>& test, const std::vector<Arguments>& candidates, const std::string& file, int lineNumber)
+			{
+				// nothing simpler, the arguments are already as small as they go
+				if (candidates.empty())
+					return std::nullopt;
+
+				std::vector<std::optional<test_failure>> failures(candidates.size());
+				std::atomic<size_t> next = 0;
+				std::atomic<size_t> first = candidates.size();
+
+				const TestContext* context = CurrentTest();
+				auto token = CurrentStopToken();
+
+				auto evaluate = [&]()
+				{
+					// the helpers act on behalf of the test, so they stop when it's cancelled
+					std::optional<TestScope> scope;
+					if (context)
+						scope.emplace(*context, token);
+
+					for (size_t i = next++; i < candidates.size() && i < first && !token.stop_requested(); i = next++)
+					{
+						try
+						{
+							failures[i] = Evaluate(test, candidates[i], file, lineNumber);
+						}
+						catch (const test_cancelled&)
+						{
+							return;
+						}
+
+						for (size_t lowest = first; failures[i] && i < lowest && !first.compare_exchange_weak(lowest, i); )
+						{}
+					}
+				};
+
+				auto helpers = TestHelpers::Borrow(candidates.size() - 1, evaluate);
+				evaluate();
+				TestHelpers::Wait(helpers);
+
+				CheckCancelled();
+				if (first == candidates.size())
+					return std::nullopt;
+				return std::pair{ first.load(), *failures[first] };
+			}
+		}
+
+		// Runs trials [firstTrial, firstTrial + numTrials) of a property. The first that fails is shrunk to the
+		// simplest arguments that still fail, which are reported along with the failure they cause.
+		template<typename Arguments>
+		void Check(const std::function<void(const Arguments&)>& test, const Property<Arguments>& property, std::string_view name,
+			size_t firstTrial, size_t numTrials, const std::string& file, int lineNumber)
+		{
+			for (size_t trial = firstTrial; trial < firstTrial + numTrials; ++trial)
+			{
+				CheckCancelled();
+
+				Random random(SeedFor(name, trial));
+				auto arguments = property.Generate(random);
+				auto failure = details::Evaluate(test, arguments, file, lineNumber);
+				if (!failure)
+					continue;
+
+				size_t numShrinks = 0;
+				for (; numShrinks < MaxShrinks; ++numShrinks)
+				{
+					auto candidates = property.Shrink(arguments);
+					auto simpler = details::FirstFailing(test, candidates, file, lineNumber);
+					if (!simpler)
+						break;
+
+					arguments = std::move(candidates[simpler->first]);
+					failure = std::move(simpler->second);
+				}
+
+				throw test_failure(std::format("{} falsified by ({}) on trial {} after {} shrinks", failure->error(),
+					tuple_utils::to_string(arguments), trial, numShrinks), failure->filename(), failure->linenumber());
+			}
+		}
+	}
+
 	template <typename signature>
 	struct TestGenerator {};
 
@@ -100,6 +296,10 @@ namespace lsn::test_framework
 		// Test Definition Details
 		TestConcurrency _concurrency = TestConcurrency::Any;
 		std::chrono::milliseconds _timeout{ 0 };
+		std::vector<TestResource> _resources;
+		std::optional<BenchmarkOptions> _benchmark;
+		std::optional<uint64_t> _maxAllocations;
+		bool _explicit = false;
 
 	public:
 
@@ -123,8 +323,57 @@ namespace lsn::test_framework
 			return *(static_cast<TestGenerator<signature>*>(this));
 		}
 
+		// Naming a resource again only narrows its capacity, a test holds each resource once
+		TestGenerator<signature>& Uses(const std::string& resource, int capacity = 1)
+		{
+			capacity = std::max(capacity, 1);
+			auto it = std::find_if(_resources.begin(), _resources.end(), [&](const TestResource& used) { return used.Name == resource; });
+			if (it != _resources.end())
+				it->Capacity = std::min(it->Capacity, capacity);
+			else
+				_resources.push_back({ resource, capacity });
+			return *(static_cast<TestGenerator<signature>*>(this));
+		}
+
+		TestGenerator<signature>& AsBenchmark()
+		{
+			_benchmark.emplace();
+			_concurrency = TestConcurrency::Exclusive;
+			return *(static_cast<TestGenerator<signature>*>(this));
+		}
+
+		TestGenerator<signature>& SetWarmup(std::chrono::nanoseconds warmup)
+		{
+			AsBenchmarkOptions().Warmup = warmup;
+			return *(static_cast<TestGenerator<signature>*>(this));
+		}
+
+		TestGenerator<signature>& SetTargetTime(std::chrono::nanoseconds target)
+		{
+			AsBenchmarkOptions().TargetTime = target;
+			return *(static_cast<TestGenerator<signature>*>(this));
+		}
+
+		// only enforced when allocations are tracked, see TestAllocations.h
+		TestGenerator<signature>& SetMaxAllocations(uint64_t maxAllocations)
+		{
+			_maxAllocations = maxAllocations;
+			return *(static_cast<TestGenerator<signature>*>(this));
+		}
+
+		// left out of RunAll, only run when it or a category it's in is run
+		TestGenerator<signature>& SetExplicit()
+		{
+			_explicit = true;
+			return *(static_cast<TestGenerator<signature>*>(this));
+		}
+
 		std::unique_ptr<TestDefinition> GenerateTestDefinition(std::function<void()> test_func) const
 		{
+			// a benchmark's body is measured rather than run the once
+			if (_benchmark)
+				test_func = [body = std::move(test_func), options = *_benchmark]() { TestBenchmark::Run(body, options); };
+
 			auto definition = std::make_unique<TestDefinition>(test_func);
 			SetDetails(definition.get());
 			return definition;
@@ -142,6 +391,38 @@ namespace lsn::test_framework
 			return test;
 		}
 
+		// A test standing for numInstances instances, run and named by index. A single instance is just a test.
+		std::unique_ptr<TestObject> GenerateInstances(std::string name, uint64_t numInstances, std::function<void(uint64_t)> instance, std::function<std::string(uint64_t)> describe) const
+		{
+			if (numInstances == 1)
+				return GenerateTestObject(describe(0), [instance]() { instance(0); });
+
+			// a benchmark's instances are each measured rather than run the once
+			if (_benchmark)
+				instance = [body = std::move(instance), options = *_benchmark](uint64_t i) { TestBenchmark::Run([&]() { body(i); }, options); };
+
+			auto definition = std::make_unique<TestDefinition>([instance, numInstances]()
+			{
+				for (uint64_t i = 0; i < numInstances; ++i)
+					instance(i);
+			});
+			SetDetails(definition.get());
+			definition->NumInstances = numInstances;
+			definition->_instance = std::move(instance);
+			definition->_describe = std::move(describe);
+
+			auto test = std::make_unique<TestObject>(name, std::move(definition));
+			SetDetails(test.get());
+			return test;
+		}
+
+		BenchmarkOptions& AsBenchmarkOptions()
+		{
+			if (!_benchmark)
+				AsBenchmark();
+			return *_benchmark;
+		}
+
 		void SetDetails(TestObject* test) const
 		{
 			test->File = _file;
@@ -152,6 +433,9 @@ namespace lsn::test_framework
 		{
 			definition->Concurrency = _concurrency;
 			definition->Timeout = _timeout;
+			definition->Resources = _resources;
+			definition->MaxAllocations = _maxAllocations;
+			definition->Explicit = _explicit;
 		}
 	};
 
@@ -176,7 +460,20 @@ namespace lsn::test_framework
 		using ArgVector = std::vector<ArgStorage>;
 
 		std::function<void(Args...)> _test;
-		std::vector<ArgStorage> _arguments;
+
+		// A source of instances, with the arguments of each built on demand by index
+		struct Source
+		{
+			size_t Size = 0;
+			std::function<ArgStorage(size_t)> At;
+		};
+
+		// Creates each source, in the order they were declared. Only run once the test is expanded.
+		std::vector<std::function<Source()>> _sources;
+
+		// Creates the generators of a property test, its trials are split between instances of TrialsPerInstance
+		std::function<properties::Property<ArgStorage>()> _property;
+		size_t _trials = properties::DefaultTrials;
 
 		//TestGenerator((*test)(Args...), const std::string& name, const std::string& file, int lineNumber)
 		TestGenerator(std::function<void(Args...)> test, const std::string& name, const std::string& file, int lineNumber)
@@ -184,17 +481,55 @@ namespace lsn::test_framework
 		{
 			_test = test;
 		}
+
+		// factory returns one of the indexed sources from TestValues.h
+		TestGenerator& AddTestsFromIndexed(const auto& factory)
+		{
+			_sources.push_back([factory]()
+			{
+				auto source = std::invoke(factory);
+				auto size = static_cast<size_t>(source.size());
+				return Source{ size, [source = std::move(source)](size_t index) { return ArgStorage(source[index]); } };
+			});
+
+			return *this;
+		}
 	
-		TestGenerator& AddTestsFromSource(const auto& generator)
+		// factory returns the ForAll of TestProperty.h
+		TestGenerator& AddTestsFromProperty(const auto& factory)
 		{
-			auto arguments = std::invoke(generator);
-			_arguments.reserve(arguments.size() + _arguments.size());
-			for (const auto& argument : arguments)
-				_arguments.push_back(argument);
+			_property = [factory]()
+			{
+				using Generated = typename std::invoke_result_t<decltype(factory)>::value_type;
+
+				auto forAll = std::invoke(factory);
+				return properties::Property<ArgStorage>
+				{
+					[forAll](properties::Random& random) { return ArgStorage(forAll(random)); },
+					[forAll](const ArgStorage& arguments)
+					{
+						std::vector<ArgStorage> candidates;
+						for (auto&& candidate : forAll.Shrink(Generated(arguments)))
+							candidates.emplace_back(std::move(candidate));
+						return candidates;
+					}
+				};
+			};
+
+			return *this;
+		}
 
+		TestGenerator& SetTrials(size_t trials)
+		{
+			_trials = trials;
 			return *this;
 		}
 
+		TestGenerator& AddTestsFromSource(const auto& generator)
+		{
+			return AddTestsFromIndexed([generator]() { return values::ValueSource(generator); });
+		}
+
 		TestGenerator& AddTestsFromValues(Args... args)
 		{
 			auto tuple = std::make_tuple(args...);
@@ -209,28 +544,108 @@ namespace lsn::test_framework
 
 		TestGenerator& AddTestsFromValue(const ArgStorage& args)
 		{
-			_arguments.push_back(args);
-			return *this;
+			return AddTestsFromIndexed([args]() { return values::VectorSource(std::vector<ArgStorage>{ args }); });
 		}
 
+		// A single node that creates the test of each source when it's expanded
 		std::unique_ptr<TestObject> Generate()
 		{
-			assert(_arguments.size() > 0);
+			assert(_sources.size() > 0 || _property);
 
-			auto root = std::make_unique<TestObject>(this->_name);
+			auto root = std::make_unique<TestObject>(this->_name, [generator = *this]() { return generator.Instantiate(); });
 			this->SetDetails(root.get());
 
-			for (const auto& arguments : _arguments)
+			if constexpr ((fuzzing::Fuzzable<Args> && ...))
+				root->Fuzz = GenerateFuzzTarget();
+
+			return root;
+		}
+
+		// One test per source, standing for each of its instances by index, which the runner schedules in ranges.
+		// Nothing is created per instance, an instance's arguments are built as it runs and its name once it's reported.
+		std::vector<std::unique_ptr<TestObject>> Instantiate() const
+		{
+			// every source shares the one copy of the test
+			auto test = std::make_shared<const std::function<void(Args...)>>(_test);
+
+			std::vector<std::unique_ptr<TestObject>> tests;
+			uint64_t first = 0; // numbered on from the sources before, so each name stays unique
+			for (size_t index = 0; index < _sources.size(); ++index)
 			{
-				auto instanceTest = [localTest = _test, arguments]()
+				// a source that can't be enumerated, such as a Combine too large to count, fails in its place
+				std::shared_ptr<const Source> source;
+				try
 				{
-					return std::apply(localTest, arguments);
-				};
-				
-				root->Add(this->GenerateTestObject(GenerateTestName(arguments), instanceTest));
+					source = std::make_shared<const Source>(std::invoke(_sources[index]));
+				}
+				catch (const std::exception& error)
+				{
+					auto failure = test_failure(error.what(), this->_file, this->_lineNumber);
+					tests.push_back(this->GenerateTestObject(std::format("{}[source {}]", this->_name, index), [failure]() { throw failure; }));
+					continue;
+				}
+
+				if (source->Size == 0)
+					continue;
+
+				auto instance = [test, source](uint64_t i) { std::apply(*test, source->At(i)); };
+				auto describe = [source, name = this->_name](uint64_t i) { return std::format("{0}({1})", name, tuple_utils::to_string(source->At(i))); };
+				auto name = std::format("{}[{}..{}]", this->_name, first, first + source->Size - 1);
+
+				tests.push_back(this->GenerateInstances(name, source->Size, instance, describe));
+				first += source->Size;
 			}
 
-			return root;
+			if (!_property)
+				return tests;
+
+			// a property's trials are shared out between its instances, so the workers run them side by side
+			auto property = std::make_shared<const properties::Property<ArgStorage>>(std::invoke(_property));
+			auto numInstances = (_trials + properties::TrialsPerInstance - 1) / properties::TrialsPerInstance;
+			auto trials = [trials = _trials](uint64_t i)
+			{
+				auto first = i * properties::TrialsPerInstance;
+				return std::pair<size_t, size_t>(first, std::min<size_t>(properties::TrialsPerInstance, trials - first));
+			};
+
+			auto instance = [test, property, trials, name = this->_name, file = this->_file, lineNumber = this->_lineNumber](uint64_t i)
+			{
+				auto [first, numTrials] = trials(i);
+				auto run = [&test](const ArgStorage& arguments) { std::apply(*test, arguments); };
+				properties::Check<ArgStorage>(run, *property, name, first, numTrials, file, lineNumber);
+			};
+
+			auto describe = [trials, name = this->_name](uint64_t i)
+			{
+				auto [first, numTrials] = trials(i);
+				return std::format("{}[{}..{}]", name, first, first + numTrials - 1);
+			};
+
+			if (numInstances > 0)
+				tests.push_back(this->GenerateInstances(std::format("{}[{} trials]", this->_name, _trials), numInstances, instance, describe));
+
+			return tests;
+		}
+
+		std::shared_ptr<const FuzzTarget> GenerateFuzzTarget() const
+		{
+			auto decode = [](std::span<const uint8_t> bytes)
+			{
+				// braced initialization, so the arguments are read from the bytes in order
+				fuzzing::FuzzInput input(bytes);
+				return ArgStorage{ input.Consume<Args>()... };
+			};
+
+			auto target = std::make_shared<FuzzTarget>();
+			target->Run = [test = _test, decode](std::span<const uint8_t> bytes) { std::apply(test, decode(bytes)); };
+			target->Describe = [decode](std::span<const uint8_t> bytes)
+			{
+				auto arguments = decode(bytes);
+				std::string literals;
+				std::apply([&literals](const auto&... values) { (..., (literals += (literals.empty() ? "" : ", ") + fuzzing::Literal(values))); }, arguments);
+				return std::format("ValueCase({})", literals);
+			};
+			return target;
 		}
 
 		std::string GenerateTestName(const ArgStorage& arguments) const {
@@ -0,0 +1,344 @@
+#include "TestFuzzer.h"
+#include "TestHistory.h"
+#include "TestObject.h"
+#include "TestResult.h"
+#include "TestCancellation.h"
+#include "AtomicBitset.h"
+#include "TestExecutor.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#if defined __linux__
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// The coverage callbacks mustn't be instrumented themselves
+#if defined __clang__
+#define NoCoverage __attribute__((no_sanitize("coverage")))
+#elif defined __GNUC__
+#define NoCoverage __attribute__((no_sanitize_coverage))
+#else
+#define NoCoverage
+#endif
+
+namespace
+{
+	constexpr size_t CoverageMapSize = 1 << 16;
+
+	// The edges hit by the input running on this thread, only set while a fuzzer is running one
+	constinit thread_local uint8_t* t_coverage = nullptr;
+	// The input running on this thread, for the crash handler
+	constinit thread_local const std::vector<uint8_t>* t_input = nullptr;
+}
+
+// -fsanitize-coverage=trace-pc-guard, each edge gets a guard numbered when its module is loaded
+extern "C" NoCoverage void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop)
+{
+	static uint32_t numGuards = 0;
+	if (start == stop || *start)
+		return;
+
+	for (auto* guard = start; guard < stop; ++guard)
+		*guard = ++numGuards;
+}
+
+extern "C" NoCoverage void __sanitizer_cov_trace_pc_guard(uint32_t* guard)
+{
+	if (auto* coverage = t_coverage)
+		coverage[*guard % CoverageMapSize] = 1;
+}
+
+// -fsanitize-coverage=trace-pc, where edges are told apart by where they're called from
+extern "C" NoCoverage void __sanitizer_cov_trace_pc()
+{
+	if (auto* coverage = t_coverage)
+	{
+		auto pc = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+		coverage[(pc ^ (pc >> 16)) % CoverageMapSize] = 1;
+	}
+}
+
+namespace lsn::test_framework
+{
+	namespace
+	{
+		std::filesystem::path CrashFileOf(const FuzzOptions& options)
+		{
+			auto file = options.FindingsFile;
+			file += ".crash";
+			return file;
+		}
+
+		void AppendFinding(const FuzzOptions& options, const std::string& test, const FuzzFinding& finding)
+		{
+			std::ofstream stream(options.FindingsFile, std::ios::app);
+			stream << "// " << test << ": " << finding.Error << "\n" << finding.ValueCase << "\n";
+		}
+
+		void Mutate(std::vector<uint8_t>& input, std::mt19937_64& random, const std::vector<uint8_t>& other, size_t maxSize)
+		{
+			static constexpr uint8_t Interesting[] = { 0, 1, 2, 0x7f, 0x80, 0xfe, 0xff };
+
+			auto position = [&](size_t size) { return std::uniform_int_distribution<size_t>(0, size - 1)(random); };
+
+			for (int numMutations = 1 + random() % 4; numMutations > 0; --numMutations)
+			{
+				switch (input.empty() ? 2 : random() % 8)
+				{
+				case 0: input[position(input.size())] ^= uint8_t(1 << (random() % 8)); break;
+				case 1: input[position(input.size())] = uint8_t(random()); break;
+				case 2: input.insert(input.begin() + (input.empty() ? 0 : position(input.size() + 1)), uint8_t(random())); break;
+				case 3: input.erase(input.begin() + position(input.size())); break;
+				case 4: input[position(input.size())] = Interesting[random() % std::size(Interesting)]; break;
+				case 5: input[position(input.size())] += uint8_t(1 + random() % 8) * (random() % 2 ? 1 : -1); break;
+				case 6:
+					// splice in part of another input from the corpus
+					if (!other.empty())
+					{
+						auto begin = position(other.size());
+						auto end = begin + 1 + position(other.size() - begin);
+						input.insert(input.begin() + position(input.size() + 1), other.begin() + begin, other.begin() + end);
+					}
+					break;
+				case 7:
+				{
+					auto begin = position(input.size());
+					std::vector<uint8_t> chunk(input.begin() + begin, input.begin() + begin + 1 + position(input.size() - begin));
+					input.insert(input.begin() + position(input.size() + 1), chunk.begin(), chunk.end());
+					break;
+				}
+				}
+			}
+
+			if (input.size() > maxSize)
+				input.resize(maxSize);
+		}
+
+#if defined __linux__
+		// Written before the handlers are installed and only read by them
+		std::string g_crashFile;
+		std::string g_crashTest;
+
+		constexpr int CrashSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+		// Leaves the input behind for the next session, using nothing but async signal safe calls
+		void OnCrash(int signal)
+		{
+			if (const auto* input = t_input)
+			{
+				if (int file = ::open(g_crashFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644); file >= 0)
+				{
+					char header[32];
+					int length = 0;
+					header[length++] = '\n';
+					for (int divisor = 100; divisor > 0; divisor /= 10)
+						header[length++] = char('0' + (signal / divisor) % 10);
+					header[length++] = '\n';
+
+					(void)!::write(file, g_crashTest.data(), g_crashTest.size());
+					(void)!::write(file, header, length);
+
+					static constexpr char Hex[] = "0123456789abcdef";
+					for (uint8_t byte : *input)
+					{
+						char digits[2] = { Hex[byte >> 4], Hex[byte & 0xf] };
+						(void)!::write(file, digits, 2);
+					}
+					(void)!::write(file, "\n", 1);
+					::close(file);
+				}
+			}
+
+			::signal(signal, SIG_DFL);
+			::raise(signal);
+		}
+
+		// Catches crashes for as long as it's in scope
+		struct CrashScope
+		{
+			CrashScope(const std::filesystem::path& file, const std::string& test)
+			{
+				g_crashFile = file.string();
+				g_crashTest = test;
+
+				struct sigaction action {};
+				action.sa_handler = OnCrash;
+				sigemptyset(&action.sa_mask);
+				for (size_t i = 0; i < std::size(CrashSignals); ++i)
+					sigaction(CrashSignals[i], &action, &_previous[i]);
+			}
+
+			~CrashScope()
+			{
+				for (size_t i = 0; i < std::size(CrashSignals); ++i)
+					sigaction(CrashSignals[i], &_previous[i], nullptr);
+			}
+
+			struct sigaction _previous[std::size(CrashSignals)];
+		};
+#else
+		struct CrashScope
+		{
+			CrashScope(const std::filesystem::path&, const std::string&) {}
+		};
+#endif
+
+		// A crash left behind by a previous session of this test, as "<test>\n<signal>\n<input as hex>"
+		std::optional<FuzzFinding> RecoverCrash(const FuzzOptions& options, const std::string& test, const FuzzTarget& target)
+		{
+			auto file = CrashFileOf(options);
+			std::ifstream stream(file);
+			std::string crashedTest, signal, hex;
+			if (!stream || !std::getline(stream, crashedTest) || crashedTest != test)
+				return std::nullopt;
+
+			std::getline(stream, signal);
+			std::getline(stream, hex);
+			stream.close();
+			std::filesystem::remove(file);
+
+			FuzzFinding finding;
+			for (size_t i = 0; i + 1 < hex.size(); i += 2)
+				finding.Input.push_back(uint8_t(std::stoi(hex.substr(i, 2), nullptr, 16)));
+			finding.Error = std::format("crashed with signal {}", std::stoi(signal));
+			finding.ValueCase = target.Describe(finding.Input);
+			AppendFinding(options, test, finding);
+			return finding;
+		}
+	}
+
+	bool TestFuzzer::CanRecordCrashes()
+	{
+#if defined __linux__
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	FuzzReport TestFuzzer::Fuzz(const TestObject& test, const FuzzOptions& options, std::stop_token token)
+	{
+		FuzzReport report;
+		report.Test = TestHistory::KeyOf(test);
+		if (!test.Fuzz)
+			return report;
+
+		const auto& target = *test.Fuzz;
+
+		// The crash handlers and the file they write to are the process's, so only one test is fuzzed at a time
+		static std::mutex s_fuzzing;
+		std::lock_guard fuzzing(s_fuzzing);
+
+		// the crash has to be fixed, or added as a value case, before there's any point fuzzing further
+		if (auto crash = RecoverCrash(options, report.Test, target))
+		{
+			report.Finding = std::move(crash);
+			return report;
+		}
+
+		std::mutex mutex;
+		std::vector<std::vector<uint8_t>> corpus{ {} };
+		AtomicBitset covered;
+		covered.Reserve(CoverageMapSize);
+
+		std::atomic<size_t> numRuns = 0;
+		std::atomic<size_t> numEdges = 0;
+		std::stop_source found;
+		auto deadline = std::chrono::steady_clock::now() + options.MaxDuration;
+
+		CrashScope crashes(CrashFileOf(options), report.Test);
+
+		auto loop = [&](uint64_t seed)
+		{
+			std::mt19937_64 random(seed);
+			std::vector<uint8_t> coverage(CoverageMapSize);
+			std::vector<uint8_t> input, other;
+
+			while (!token.stop_requested() && !found.stop_requested() && std::chrono::steady_clock::now() < deadline
+				&& numRuns++ < options.MaxRuns)
+			{
+				// each loop wanders on from its last input, now and then starting again from one in the corpus.
+				// Without coverage the corpus never grows, so this is all that lets inputs get any longer.
+				{
+					std::lock_guard lock(mutex);
+					if (random() % 16 == 0)
+						input = corpus[random() % corpus.size()];
+					other = corpus[random() % corpus.size()];
+				}
+				Mutate(input, random, other, options.MaxInputSize);
+
+				std::optional<std::string> error;
+				std::fill(coverage.begin(), coverage.end(), uint8_t(0));
+				t_coverage = coverage.data();
+				t_input = &input;
+				try
+				{
+					target.Run(input);
+				}
+				catch (const test_failure& failure)
+				{
+					error = failure.FormattedString();
+				}
+				catch (const test_cancelled&)
+				{
+				}
+				catch (const std::exception& unexpected_failure)
+				{
+					error = unexpected_failure.what();
+				}
+				catch (...)
+				{
+					error = "uknown exception encountered";
+				}
+				t_input = nullptr;
+				t_coverage = nullptr;
+
+				// an input is kept if it reached an edge no other input has
+				size_t newEdges = 0;
+				for (size_t edge = 0; edge < CoverageMapSize; ++edge)
+				{
+					if (coverage[edge] && !covered.TestAndSet(edge))
+						++newEdges;
+				}
+
+				if (newEdges > 0)
+				{
+					numEdges += newEdges;
+					std::lock_guard lock(mutex);
+					corpus.push_back(input);
+				}
+
+				if (error)
+				{
+					std::lock_guard lock(mutex);
+					if (!found.stop_requested())
+					{
+						report.Finding = FuzzFinding{ target.Describe(input), *error, input };
+						found.request_stop();
+					}
+				}
+			}
+		};
+
+		// one loop here and one on each of the helpers we get, every loop with a seed of its own
+		auto numLoops = options.NumThreads > 0 ? size_t(options.NumThreads) : TestHelpers::Capacity() + 1;
+		std::atomic<uint64_t> numHelping = 0;
+		auto helpers = TestHelpers::Borrow(numLoops - 1, [&]() { loop(options.Seed + ++numHelping); });
+		loop(options.Seed);
+		TestHelpers::Wait(helpers);
+
+		report.NumRuns = std::min(numRuns.load(), options.MaxRuns);
+		report.NumEdges = numEdges;
+		report.CorpusSize = corpus.size();
+		if (report.Finding)
+			AppendFinding(options, report.Test, *report.Finding);
+		return report;
+	}
+}
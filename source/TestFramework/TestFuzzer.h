@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Fuzzing of the tests that take arguments. Arguments are decoded from a stream of bytes, which are mutated
+// and kept whenever they reach code no other input has, going by the edge coverage of the compiler's
+// instrumentation. Build with -fsanitize-coverage=trace-pc-guard (clang) or -fsanitize-coverage=trace-pc (gcc)
+// for the coverage, without it inputs are still mutated but blindly.
+namespace lsn::test_framework
+{
+	struct TestObject;
+
+	namespace fuzzing
+	{
+		template<typename T> struct is_fuzzable : std::bool_constant<std::is_arithmetic_v<T>> {};
+		template<> struct is_fuzzable<std::string> : std::true_type {};
+		template<typename T> struct is_fuzzable<std::vector<T>> : is_fuzzable<T> {};
+
+		// The argument types that can be decoded from bytes
+		template<typename T>
+		concept Fuzzable = is_fuzzable<T>::value;
+
+		// Reads arguments from the input. Once it runs out every value is zero, or empty, so any input decodes.
+		class FuzzInput
+		{
+		public:
+			explicit FuzzInput(std::span<const uint8_t> bytes)
+				: _bytes(bytes)
+			{}
+
+			template<Fuzzable T>
+			T Consume()
+			{
+				if constexpr (std::is_same_v<T, bool>)
+				{
+					return (ConsumeByte() & 1) != 0;
+				}
+				else if constexpr (std::is_arithmetic_v<T>)
+				{
+					uint8_t bytes[sizeof(T)]{};
+					auto size = std::min(sizeof(T), Remaining());
+					std::memcpy(bytes, _bytes.data() + _offset, size);
+					_offset += size;
+
+					T value;
+					std::memcpy(&value, bytes, sizeof(T));
+					return value;
+				}
+				else if constexpr (std::is_same_v<T, std::string>)
+				{
+					auto size = std::min<size_t>(ConsumeByte(), Remaining());
+					std::string value(reinterpret_cast<const char*>(_bytes.data() + _offset), size);
+					_offset += size;
+					return value;
+				}
+				else
+				{
+					T values;
+					for (size_t size = ConsumeByte(); values.size() < size && Remaining() > 0; )
+						values.push_back(Consume<typename T::value_type>());
+					return values;
+				}
+			}
+
+			size_t Remaining() const { return _bytes.size() - _offset; }
+
+		private:
+			uint8_t ConsumeByte() { return Remaining() > 0 ? _bytes[_offset++] : 0; }
+
+			std::span<const uint8_t> _bytes;
+			size_t _offset = 0;
+		};
+
+		// A value as C++ that ValueCase will accept for an argument of its type
+		template<Fuzzable T>
+		std::string Literal(const T& value)
+		{
+			if constexpr (std::is_same_v<T, bool>)
+			{
+				return value ? "true" : "false";
+			}
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+			{
+				// the negative of the minimum isn't a literal of the type
+				if (value == std::numeric_limits<T>::min())
+					return std::format("({} - 1)", static_cast<long long>(value) + 1);
+				return std::format("{}", static_cast<long long>(value));
+			}
+			else if constexpr (std::is_integral_v<T>)
+			{
+				return std::format("{}ull", static_cast<unsigned long long>(value));
+			}
+			else if constexpr (std::is_floating_point_v<T>)
+			{
+				if (std::isnan(value))
+					return "std::numeric_limits<double>::quiet_NaN()";
+				if (std::isinf(value))
+					return value > 0 ? "std::numeric_limits<double>::infinity()" : "-std::numeric_limits<double>::infinity()";
+				return std::format("{}", value);
+			}
+			else if constexpr (std::is_same_v<T, std::string>)
+			{
+				// octal escapes are always three digits, so they can't run into the characters after them
+				std::string literal = "\"";
+				for (unsigned char c : value)
+				{
+					if (c == '"' || c == '\\')
+						literal += std::format("\\{}", char(c));
+					else if (c >= 0x20 && c < 0x7f)
+						literal += char(c);
+					else
+						literal += { '\\', char('0' + (c >> 6)), char('0' + ((c >> 3) & 7)), char('0' + (c & 7)) };
+				}
+				literal += "\"";
+
+				if (value.find('\0') != std::string::npos)
+					return std::format("std::string({}, {})", literal, value.size());
+				return literal;
+			}
+			else
+			{
+				std::string literal = "{";
+				for (size_t i = 0; i < value.size(); ++i)
+					literal += (i == 0 ? "" : ", ") + Literal<typename T::value_type>(value[i]);
+				return literal + "}";
+			}
+		}
+	}
+
+	// How a test is run from bytes, set on the parameterized tests whose arguments are all Fuzzable
+	struct FuzzTarget
+	{
+		// Decodes the arguments and runs the test with them
+		std::function<void(std::span<const uint8_t>)> Run;
+		// The arguments decoded from the bytes, as a ValueCase(...) that reproduces them
+		std::function<std::string(std::span<const uint8_t>)> Describe;
+	};
+
+	struct FuzzOptions
+	{
+		size_t MaxRuns = 100000;
+		std::chrono::milliseconds MaxDuration{ 10000 };
+		int NumThreads = 0; // one loop per thread, 0 is one per core, either way only as many as there are helpers free
+		size_t MaxInputSize = 256;
+		uint64_t Seed = 0;
+		// Every failure is appended here as a ValueCase to add to the test.
+		// A crash is left in FindingsFile.crash by the dying process and moved across by the next session.
+		std::filesystem::path FindingsFile = "FuzzFindings.txt";
+	};
+
+	struct FuzzFinding
+	{
+		std::string ValueCase;
+		std::string Error;
+		std::vector<uint8_t> Input;
+	};
+
+	struct FuzzReport
+	{
+		std::string Test;
+		size_t NumRuns = 0;
+		size_t NumEdges = 0; // zero when the build isn't instrumented
+		size_t CorpusSize = 0;
+		std::optional<FuzzFinding> Finding; // the first failure, fuzzing stops once one is found
+	};
+
+	struct TestFuzzer
+	{
+		// Whether crashes can be caught and saved, otherwise they only take the process down
+		static bool CanRecordCrashes();
+
+		// Only one test is fuzzed at a time, as the crash handlers are the process's, any other call waits its turn
+		static FuzzReport Fuzz(const TestObject& test, const FuzzOptions& options = FuzzOptions(), std::stop_token token = {});
+	};
+}
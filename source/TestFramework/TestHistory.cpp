@@ -0,0 +1,136 @@
+#include "TestHistory.h"
+
+#include "TestRunner.h"
+#include "TestResult.h"
+#include "TestObject.h"
+#include "TestDefinition.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace lsn::test_framework
+{
+
+std::string TestHistory::KeyOf(const TestObject& test)
+{
+	std::string key = test.Name;
+	for (const auto* parent = test.Parent; parent; parent = parent->Parent)
+		key = parent->Name + "/" + key;
+	return key;
+}
+
+// One test per line: "<average ns> <samples> <path>", the path goes last as it can contain spaces
+bool TestHistory::Load(const std::filesystem::path& file)
+{
+	std::ifstream stream(file);
+	if (!stream)
+		return false;
+
+	int64_t average;
+	uint32_t samples;
+	std::string key;
+	while (stream >> average >> samples && std::getline(stream >> std::ws, key))
+		_entries[key] = { std::chrono::nanoseconds(average), samples };
+
+	return true;
+}
+
+bool TestHistory::Save(const std::filesystem::path& file) const
+{
+	std::ofstream stream(file, std::ios::trunc);
+	if (!stream)
+		return false;
+
+	for (const auto& [key, entry] : _entries)
+		stream << entry.Average.count() << ' ' << entry.Samples << ' ' << key << '\n';
+
+	return stream.good();
+}
+
+void TestHistory::Record(const std::string& key, std::chrono::nanoseconds duration)
+{
+	auto& entry = _entries[key];
+
+	// an exponential moving average, so a test that has recently become slower is picked up quickly
+	if (entry.Samples == 0)
+		entry.Average = duration;
+	else
+		entry.Average += (duration - entry.Average) / 4;
+
+	entry.Samples++;
+}
+
+void TestHistory::Record(std::span<const TestContext> tests)
+{
+	for (const auto& context : tests)
+	{
+		if (!context.Result->HasRun())
+			continue;
+
+		// What running it cost rather than its wall time, its ranges may have run alongside each other. Only some
+		// of a test's instances were run, so it's recorded as if it had run them all.
+		auto taken = context.Result->Cost();
+		if (auto run = context.Instances.Size(); run > 0 && run < context.Definition->NumInstances)
+			taken = std::chrono::duration_cast<std::chrono::nanoseconds>(taken * (double(context.Definition->NumInstances) / run));
+
+		Record(KeyOf(*context.Definition->_parent), taken);
+	}
+}
+
+std::optional<std::chrono::nanoseconds> TestHistory::Find(const std::string& key) const
+{
+	auto it = _entries.find(key);
+	if (it == _entries.end())
+		return std::nullopt;
+
+	return it->second.Average;
+}
+
+void TestHistory::Estimate(std::span<TestContext> tests) const
+{
+	struct Siblings
+	{
+		std::chrono::nanoseconds Total{ 0 };
+		size_t Count = 0;
+	};
+
+	std::unordered_map<const TestObject*, Siblings> siblings;
+	std::vector<std::chrono::nanoseconds> known;
+	std::vector<TestContext*> unknown;
+
+	for (auto& context : tests)
+	{
+		const auto* test = context.Definition->_parent;
+		if (auto duration = Find(KeyOf(*test)))
+		{
+			context.EstimatedDuration = *duration;
+			known.push_back(*duration);
+
+			auto& group = siblings[test->Parent];
+			group.Total += *duration;
+			group.Count++;
+		}
+		else
+		{
+			unknown.push_back(&context);
+		}
+	}
+
+	if (unknown.empty() || known.empty())
+		return;
+
+	auto median = known.begin() + known.size() / 2;
+	std::nth_element(known.begin(), median, known.end());
+
+	for (auto* context : unknown)
+	{
+		auto group = siblings.find(context->Definition->_parent->Parent);
+		if (group != siblings.end())
+			context->EstimatedDuration = group->second.Total / group->second.Count;
+		else
+			context->EstimatedDuration = *median;
+	}
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+namespace lsn::test_framework
+{
+	struct TestContext;
+	struct TestObject;
+
+	// How long each test has taken in previous sessions, keyed on its full path so that it survives
+	// tests being added or reordered. Used to dispatch the longest tests first.
+	// Only touched by the runner between tests, so it isn't synchronized.
+	struct TestHistory
+	{
+		struct Entry
+		{
+			std::chrono::nanoseconds Average{ 0 };
+			uint32_t Samples = 0;
+		};
+
+		static std::string KeyOf(const TestObject& test);
+
+		bool Load(const std::filesystem::path& file);
+		bool Save(const std::filesystem::path& file) const;
+
+		void Record(const std::string& key, std::chrono::nanoseconds duration);
+		void Record(std::span<const TestContext> tests);
+		std::optional<std::chrono::nanoseconds> Find(const std::string& key) const;
+
+		// Fills in the estimated duration of every test. Tests without any history take the mean of their
+		// siblings (e.g. the other instances of a parameterized test), failing that the median of everything known.
+		void Estimate(std::span<TestContext> tests) const;
+
+		size_t Size() const { return _entries.size(); }
+
+	private:
+		std::unordered_map<std::string, Entry> _entries;
+	};
+}
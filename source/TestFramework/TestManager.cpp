@@ -2,48 +2,108 @@
 #include "TestRunner.h"
 #include "foundation/utils/StringUtils.h"
 
+#include <cassert>
+
 using namespace lsn::test_framework;
 
+TestManager::TestManager()
+	: _uiThread(std::this_thread::get_id())
+{
+	_testRunner.HistoryFile = "TestHistory.txt";
+	_testRunner.BaselineFile = "TestBaselines.txt";
+}
+
+// The counts are kept up to date by the runner, so this never has to visit the tests below the category
 TestResultStatus TestManager::DetermineStatus(const TestObject* category) const
 {
-	TestResultStatus categoryStatus = TestResultStatus::Passed;
+	return category->Status();
+}
 
-	if (category->Definition)
+void TestManager::IndexTests()
+{
+	std::call_once(_indexed, [this]()
 	{
-		categoryStatus = DetermineStatus(category->Definition.get());
-	}
+		BuildTestTree(RegisteredCategories(), RegisteredTests(), _categories);
+		Reindex();
+	});
+}
 
-	for (const auto& test : category->Children)
+// Tests keep their index, so only those new since the last time are given a result
+void TestManager::Reindex()
+{
+	_registry = {};
+	for (auto& category : _categories)
+		_registry.Add(category);
+
+	auto index = (uint32_t)_testResults.size();
+	_registry.ForEachTest([&](const TestDefinition* test)
 	{
-		categoryStatus = std::max(categoryStatus, DetermineStatus(test.get()));
-	}
+		if (test->Index == TestDefinition::Unindexed)
+			const_cast<TestDefinition*>(test)->Index = index++;
+	});
 
-	return categoryStatus;
+	_testResults.resize(index);
 }
 
-TestResultStatus TestManager::DetermineStatus(const TestDefinition* definition) const
+TestResult& TestManager::ResultFor(const TestDefinition* definition)
+{
+	assert(std::this_thread::get_id() == _uiThread);
+	if (auto* result = EditResult(definition))
+		return *result;
+
+	const_cast<TestDefinition*>(definition)->Index = (uint32_t)_testResults.size();
+	return _testResults.emplace_back();
+}
+
+bool TestManager::IsRegistered(const TestObject& object) const
+{
+	const auto& registry = Registry();
+	return object.Node < registry.Size() && &registry.Object(object.Node) == &object;
+}
+
+void TestManager::Expand(const TestObject& object)
+{
+	assert(std::this_thread::get_id() == _uiThread);
+	if (IsRegistered(object))
+		Expand(object.Node, _registry.SubtreeEnd(object.Node));
+}
+
+// Reindexing replaces the registry and grows the results, which nothing else can be reading
+void TestManager::Expand(uint32_t begin, uint32_t end)
 {
-	const auto* result = FetchResult(definition);
+	assert(std::this_thread::get_id() == _uiThread);
 
-	if (IsQueued(definition))
+	bool expanded = false;
+	for (uint32_t node = begin; node < end; ++node)
 	{
-		if (!result->HasStarted())
-		{
-			return TestResultStatus::WaitingToRun;
-		}
-		else if (!result->HasEnded())
-		{
-			return TestResultStatus::Running;
-		}
+		if (_registry.Flags(node) & TestRegistry::IsPending)
+			expanded |= const_cast<TestObject&>(_registry.Object(node)).Expand();
 	}
 
-	if (!result->HasRun())
+	if (expanded)
+		Reindex();
+}
+
+std::vector<FuzzReport> TestManager::Fuzz(const TestObject& object, const FuzzOptions& options)
+{
+	std::vector<FuzzReport> reports;
+	if (!IsRegistered(object))
+		return reports;
+
+	// the targets are on the parameterized tests themselves, so nothing needs to be expanded
+	for (uint32_t node = object.Node; node < _registry.SubtreeEnd(object.Node); ++node)
 	{
-		return TestResultStatus::NotRun;
+		if (_registry.Object(node).Fuzz)
+			reports.push_back(TestFuzzer::Fuzz(_registry.Object(node), options));
 	}
 
-	return result->HasPassed() ? TestResultStatus::Passed : TestResultStatus::Failed;
-	
+	return reports;
+}
+
+TestResultStatus TestManager::DetermineStatus(const TestDefinition* definition) const
+{
+	// only tests in the tree have results
+	return definition->_parent ? DetermineStatus(definition->_parent) : TestResultStatus::NotRun;
 }
 
 bool TestManager::IsQueued(const TestDefinition* test) const
@@ -53,20 +113,22 @@ bool TestManager::IsQueued(const TestDefinition* test) const
 
 std::unordered_set<const TestObject*> TestManager::Query(const TestQuery& query) const
 {
-	std::unordered_set<const TestObject*> results; // = Query();
-	
-	
-	//
+	std::unordered_set<const TestObject*> results;
 
-	// this should be last as it's expensive
-	if (!query.StrMatch.empty())
+	const auto& registry = Registry();
+	for (uint32_t node = 0; node < registry.Size(); ++node)
 	{
-		/*
-		results.erase(std::remove_if(results.begin(), results.end(), [&](const TestObject* obj)
-		{
-			return StringUtils::Search(obj->Name, query.StrMatch) == 0;
-		}));
-		*/
+		if (!(registry.Flags(node) & TestRegistry::IsTest))
+			continue;
+
+		if (!query.StatusMask.test(static_cast<size_t>(registry.Object(node).Status())))
+			continue;
+
+		// this should be last as it's expensive
+		if (!query.StrMatch.empty() && registry.Name(node).find(query.StrMatch) == std::string_view::npos)
+			continue;
+
+		results.insert(&registry.Object(node));
 	}
 
 	return results;
@@ -74,27 +136,40 @@ std::unordered_set<const TestObject*> TestManager::Query(const TestQuery& query)
 
 void TestManager::RunAll()
 {
-	std::unordered_set<const TestDefinition*> tests;
-	for (const auto& category : _categories)
+	Expand(0, (uint32_t)Registry().Size());
+	const auto& registry = Registry();
+
+	std::vector<TestContext> contexts;
+	contexts.reserve(registry.NumTests());
+	registry.ForEachTest([&](const TestDefinition* test)
 	{
-		category.VisitAllTests([&](const TestDefinition* test)
-		{
-			tests.insert(test);
-		});
-	}
+		if (!test->Explicit)
+			contexts.emplace_back(test, &ResultFor(test));
+	});
 
-	Run(tests);
+	_testRunner.Run(contexts, TestOptions);
 }
 
 void TestManager::Run(const TestObject& category)
 {
-	std::unordered_set<const TestDefinition*> tests;
-	category.VisitAllTests([&](const TestDefinition* test) 
+	const auto& registry = Registry();
+
+	std::vector<TestContext> contexts;
+	auto visit = [&](const TestDefinition* test)
 	{
-		tests.insert(test); 
-	});
+		contexts.emplace_back(test, &ResultFor(test));
+	};
 
-	Run(tests);
+	// anything outside of the manager's tree isn't in the registry
+	if (IsRegistered(category))
+	{
+		Expand(category);
+		registry.ForEachTestIn(category.Node, visit);
+	}
+	else
+		category.VisitAllTests(visit);
+
+	_testRunner.Run(contexts, TestOptions);
 }
 
 void TestManager::Run(const TestDefinition& test)
@@ -102,12 +177,12 @@ void TestManager::Run(const TestDefinition& test)
 	Run({ &test });
 }
 
-void TestManager::Run(const std::unordered_set<const TestDefinition*> tests)
+void TestManager::Run(const std::unordered_set<const TestDefinition*>& tests)
 {
 	std::vector<TestContext> contexts;
 	contexts.reserve(tests.size());
 	for (const auto* test : tests)
-		contexts.emplace_back( test, EditResult(test));
+		contexts.emplace_back(test, &ResultFor(test));
 
 	_testRunner.Run(contexts, TestOptions);
 }
@@ -1,30 +1,28 @@
 #pragma once
 
 #include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <bitset>
 
 #include "TestResult.h"
 #include "TestObject.h"
+#include "TestStatus.h"
+#include "TestRegistry.h"
+#include "TestRegistration.h"
 #include "TestRunner.h"
+#include "TestFuzzer.h"
 
 // TODO:
 // Have the definitions stored in a TestDataStore rather than the manager
 // TestDefinitions should not be stored on the category itself.
 // Categories should have some way of initializing components
 
-// TODO: Remove and use an expose macro for the imgui
-#include <XEnum.h>
-ImplementXEnum(TestResultStatus,
-	XValue(Passed),
-	XValue(NotRun),
-	XValue(Failed),
-	XValue(WaitingToRun),
-	XValue(Running)
-)
-
 // this system doesnt need to be embedded, and can be done at a higher layer.
 namespace lsn::test_framework
 {
@@ -42,18 +40,27 @@ namespace lsn::test_framework
 			return _instance;
 		}
 
+		TestManager();
+
 		TestExecutionOptions TestOptions;
-		std::vector<TestObject> _categories;
+		std::deque<TestObject> _categories; // a deque so that adding a category never moves the others
 
 		TestObject* Add(const std::string& name)
 		{
 			return &(_categories.emplace_back(name));
 		}
 
+		// Every category, with the declared tests added the first time this is called
+		std::deque<TestObject>& Categories()
+		{
+			IndexTests();
+			return _categories;
+		}
+
 		void RunAll();
 		void Run(const TestObject& category);
 		void Run(const TestDefinition& definition);
-		void Run(const std::unordered_set<const TestDefinition*> tests);
+		void Run(const std::unordered_set<const TestDefinition*>& tests);
 
 		bool IsRunningTests() const;
 		bool Cancel();
@@ -72,6 +79,20 @@ namespace lsn::test_framework
 
 		std::unordered_set<const TestObject*> Query(const TestQuery& query) const;
 
+		// Creates the instances of every parameterized test at or below the object, they're otherwise only
+		// created once they're run. Only on the UI thread, which is the only one that reads the tree as it grows.
+		void Expand(const TestObject& object);
+
+		// Fuzzes every test at or below the object that takes arguments, one after another
+		std::vector<FuzzReport> Fuzz(const TestObject& object, const FuzzOptions& options = FuzzOptions());
+
+		// Every registered test flattened in pre-order, built the first time it's needed
+		const TestRegistry& Registry() const
+		{
+			const_cast<TestManager*>(this)->IndexTests();
+			return _registry;
+		}
+
 		const TestResult* FetchResult(const TestDefinition* definition) const
 		{
 			return const_cast<TestManager*>(this)->EditResult(definition);
@@ -86,19 +107,34 @@ namespace lsn::test_framework
 
 		TestResult* EditResult(const TestObject* object)
 		{
-			if (auto iter = _testResults.find(object->Id); iter != _testResults.end())
-				return &iter->second;
-			return &(_testResults[object->Id] = TestResult());
+			return object->Definition ? EditResult(object->Definition.get()) : nullptr;
 		}
 
 		TestResult* EditResult(const TestDefinition* definition)
 		{
-			return EditResult(definition->_parent);
+			IndexTests();
+			return definition->Index < _testResults.size() ? &_testResults[definition->Index] : nullptr;
 		}
 
+		// The result a test is run against. One the manager has never seen, e.g. from a tree of its own, is given a
+		// slot at the end, so it has to be on the UI thread like anything else that grows the results.
+		TestResult& ResultFor(const TestDefinition* definition);
+
+		// Every test has been declared by the time we're first used, so the tree and registry are built and each
+		// test is given a slot in the results then
+		void IndexTests();
+		void Reindex();
+
+		bool IsRegistered(const TestObject& object) const;
+		void Expand(uint32_t begin, uint32_t end);
+
 		TestRunner _testRunner;
+		std::thread::id _uiThread; // the thread that created us, which runs and expands the tests
 
-		// TODO: The key should be the definition, not the string, when we save/load from disk it can be checked via query
-		std::unordered_map<std::string, TestResult> _testResults;
+		// One result per test, indexed by TestDefinition::Index. Only ever grown at the end as parameterized tests
+		// are expanded, which never moves a result, so the workers can keep writing to theirs.
+		std::once_flag _indexed;
+		TestRegistry _registry;
+		std::deque<TestResult> _testResults;
 	};
 }
\ No newline at end of file
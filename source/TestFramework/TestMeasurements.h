@@ -0,0 +1,25 @@
+#pragma once
+
+#include <optional>
+#include <type_traits>
+
+#include "TestBenchmark.h"
+#include "TestCounters.h"
+#include "TestAllocations.h"
+#include "TestUsage.h"
+
+namespace lsn::test_framework
+{
+	// Everything measured about a test besides whether it passed, each part only where it could be measured.
+	// Kept as one block so a result swaps them in together, and a worker process sends them back as the bytes
+	// they are, which is why every part has to stay trivially copyable.
+	struct TestMeasurements
+	{
+		std::optional<BenchmarkStatistics> Benchmark; // only for benchmarks
+		std::optional<TestCounterValues> Counters; // only where the platform has counters to read
+		std::optional<AllocationStatistics> Allocations; // only when allocations are tracked
+		std::optional<ResourceUsage> Usage; // only where the platform can tell
+	};
+
+	static_assert(std::is_trivially_copyable_v<TestMeasurements>);
+}
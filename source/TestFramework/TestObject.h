@@ -4,14 +4,21 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <type_traits>
+#include <utility>
 
 #include "TestDefinition.h"
+#include "TestStatus.h"
 
 namespace lsn::test_framework
 {
 
+struct FuzzTarget;
+
 struct TestObject
 {
+	using InstanceGenerator = std::function<std::vector<std::unique_ptr<TestObject>>()>;
+
 	TestObject* Parent{ nullptr };
 
 	std::function<void()> Initialize;
@@ -21,11 +28,20 @@ struct TestObject
 
 	std::function<void()> TearDown;
 
+	static constexpr uint32_t Unregistered = ~0u;
+	uint32_t Node = Unregistered; // where it is in the TestRegistry
+
 	std::string Id;
 	std::string Name;
 	std::string File;
 	int LineNumber{ 0 };
 
+	// every test at or below this node, by status. Bookkeeping rather than part of the tree, so it can be updated through a const test
+	mutable TestStatusCounts Counts;
+
+	// set on parameterized tests whose arguments can be decoded from bytes, see TestFuzzer.h
+	std::shared_ptr<const FuzzTarget> Fuzz;
+
 
 	TestObject(const std::string& name)
 	{
@@ -38,6 +54,18 @@ struct TestObject
 	{
 		Definition = std::move(test);
 		Definition->_parent = this;
+		Counts.Add(_status, 1);
+	}
+
+	// A parameterized test, the tests of its sources are only created once something needs to show or run them.
+	// Until then it stands in for them as a single test that hasn't run. Each of those stands for every instance
+	// in its source, see TestDefinition::NumInstances.
+	TestObject(const std::string& name, InstanceGenerator instances)
+		: TestObject(name)
+	{
+		_instances = std::move(instances);
+		_parameterized = true;
+		Counts.Add(_status, 1);
 	}
 
 	TestObject(const std::string& name, std::vector<std::unique_ptr<TestObject>>&& children)
@@ -45,7 +73,10 @@ struct TestObject
 	{
 		Children = std::move(children);
 		for (auto& child : Children)
+		{
 			child->Parent = this;
+			Counts.Add(child->Counts);
+		}
 	}
 
 	TestObject(TestObject&&) = default;
@@ -56,9 +87,52 @@ struct TestObject
 	{
 		auto* test = Children.emplace_back(std::move(child)).get();
 		test->Parent = this;
+		for (auto* parent = this; parent; parent = parent->Parent)
+			parent->Counts.Add(test->Counts);
 		return test;
 	}
 
+	bool IsPending() const { return static_cast<bool>(_instances); }
+	bool IsParameterized() const { return _parameterized; }
+
+	// Creates the tests of a parameterized test's sources, false if there was nothing left to create
+	bool Expand()
+	{
+		if (!_instances)
+			return false;
+
+		auto instances = std::exchange(_instances, nullptr)();
+
+		// the sources take over from the stand in
+		for (auto* node = this; node; node = node->Parent)
+			node->Counts.Add(_status, -1);
+
+		Children.reserve(Children.size() + instances.size());
+		for (auto& instance : instances)
+			Add(std::move(instance));
+		return true;
+	}
+
+	TestResultStatus Status() const
+	{
+		return Counts.Aggregate();
+	}
+
+	// Moves this test to a new status, updating the counts of every node above it.
+	// Each test is only moved by one thread at a time, but different tests can be moved concurrently.
+	void SetStatus(TestResultStatus status) const
+	{
+		auto previous = _status.exchange(status, std::memory_order_relaxed);
+		if (previous == status)
+			return;
+
+		for (const auto* node = this; node; node = node->Parent)
+		{
+			node->Counts.Add(previous, -1);
+			node->Counts.Add(status, 1);
+		}
+	}
+
 	// TODO: Move to cpp, and find a cleaner way of doing this
 	std::vector<const TestObject*> GetChildren() const
 	{
@@ -70,26 +144,23 @@ struct TestObject
 	}
 
 	
-	// TODO: Move to cpp
-	void VisitAllTests(std::function<void(const TestObject*)> visitor) const
+	// Calls the visitor with every object below this one, and/or every test at or below it, depending on which
+	// it accepts. Whole suite operations should prefer the flattened TestRegistry.
+	template<typename Visitor>
+	void VisitAllTests(Visitor&& visitor) const
 	{
 		for (const auto& test : Children)
 		{
 			test->VisitAllTests(visitor);
-			std::invoke(visitor, test.get());
+			if constexpr (std::is_invocable_v<Visitor&, const TestObject*>)
+				std::invoke(visitor, test.get());
 		}
-	}
 
-	// TODO: Move to cpp
-	void VisitAllTests(std::function<void(const TestDefinition*)> visitor) const
-	{
-		for (const auto& test : Children)
+		if constexpr (std::is_invocable_v<Visitor&, const TestDefinition*>)
 		{
-			test->VisitAllTests(visitor);
+			if (Definition)
+				std::invoke(visitor, Definition.get());
 		}
-
-		if (Definition)
-			std::invoke(visitor, Definition.get());
 	}
 
 	const TestObject* GetRoot() const
@@ -99,5 +170,10 @@ struct TestObject
 			root = root->Parent;
 		return root;
 	}
+
+private:
+	mutable std::atomic<TestResultStatus> _status{ TestResultStatus::NotRun }; // only meaningful for tests
+	InstanceGenerator _instances;
+	bool _parameterized = false;
 };
 }
@@ -0,0 +1,485 @@
+#include "TestProcessPool.h"
+
+#include "TestRunner.h"
+#include "TestResult.h"
+#include "TestObject.h"
+#include "TestDefinition.h"
+#include "TestHistory.h"
+#include "TestForkServer.h"
+#include "TestSocket.h"
+
+#include <format>
+#include <string>
+#include <algorithm>
+
+#if defined __linux__
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#endif
+
+namespace lsn::test_framework
+{
+
+#if defined __linux__
+
+using namespace socket_utils;
+
+namespace
+{
+	// followed by the path of the test, which the worker finds in its own tree
+	struct Request
+	{
+		int64_t Timeout;
+		uint64_t Begin; // the range of its instances to run
+		uint64_t End;
+		uint32_t KeyLength;
+	};
+
+	struct ZygoteRequest
+	{
+		enum Kind : int32_t
+		{
+			Fork, // carries the socket the test process should serve, followed by the path of its test
+			Reap,
+		};
+
+		int32_t Type;
+		int32_t Pid;
+		uint32_t KeyLength;
+	};
+}
+
+bool TestProcessPool::IsSupported()
+{
+	return TestForkServer::IsRunning();
+}
+
+TestProcessPool::~TestProcessPool()
+{
+	StopZygote();
+
+	std::lock_guard lock(_mutex);
+	for (auto& worker : _idle)
+		Kill(*worker);
+	_idle.clear();
+}
+
+void TestProcessPool::Reserve(size_t numWorkers)
+{
+	std::lock_guard lock(_mutex);
+	while (_numWorkers < numWorkers)
+	{
+		auto worker = Spawn();
+		if (!worker)
+			break;
+
+		_idle.push_back(std::move(worker));
+	}
+}
+
+void TestProcessPool::Run(TestContext& context, std::chrono::milliseconds timeout, std::stop_token token)
+{
+	context.Result->Reset();
+
+	auto worker = Acquire();
+	if (!worker)
+	{
+		context.SetFailure("unable to fork a worker process");
+		return;
+	}
+
+	auto outcome = Execute(*worker, context, timeout, token);
+	if (outcome == Outcome::Completed)
+	{
+		Release(std::move(worker));
+		return;
+	}
+
+	int status = 0;
+	Replace(std::move(worker), &status);
+	if (outcome == Outcome::Lost)
+		context.SetFailure(DescribeExit(status));
+}
+
+void TestProcessPool::RunForked(TestContext& context, std::chrono::milliseconds timeout, std::stop_token token)
+{
+	context.Result->Reset();
+
+	auto worker = ForkFromZygote(TestHistory::KeyOf(*context.Definition->_parent));
+	if (!worker)
+	{
+		context.SetFailure("unable to fork a test process from the zygote");
+		return;
+	}
+
+	// the process only ever runs the one test, so it's disposed of whatever the outcome
+	auto outcome = Execute(*worker, context, timeout, token);
+	int status = Reap(*worker);
+	if (outcome == Outcome::Lost)
+		context.SetFailure(DescribeExit(status));
+}
+
+bool TestProcessPool::StartZygote()
+{
+	std::lock_guard zygoteLock(_zygoteMutex);
+	if (_zygotePid > 0)
+	{
+		// it only ever speaks when spoken to, so anything to read means it's gone
+		pollfd descriptor{ _zygoteControl, POLLIN, 0 };
+		if (poll(&descriptor, 1, 0) == 0)
+			return true;
+
+		// clean up and start a new one
+		Worker zygote{ _zygotePid, _zygoteControl };
+		std::lock_guard lock(_mutex);
+		Kill(zygote);
+		_zygotePid = _zygoteControl = -1;
+	}
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+		return false;
+
+	int pid = TestForkServer::Spawn(TestForkServer::Role::Zygote, sockets[1]);
+	close(sockets[1]);
+	if (pid < 0)
+	{
+		close(sockets[0]);
+		return false;
+	}
+
+	_zygotePid = pid;
+	_zygoteControl = sockets[0];
+	return true;
+}
+
+size_t TestProcessPool::NumWorkers() const
+{
+	std::lock_guard lock(_mutex);
+	return _numWorkers;
+}
+
+size_t TestProcessPool::NumRespawned() const
+{
+	std::lock_guard lock(_mutex);
+	return _numRespawned;
+}
+
+size_t TestProcessPool::NumForked() const
+{
+	std::lock_guard lock(_mutex);
+	return _numForked;
+}
+
+TestProcessPool::Outcome TestProcessPool::Execute(Worker& worker, TestContext& context, std::chrono::milliseconds timeout, std::stop_token token)
+{
+	context.Result->Begin(std::chrono::high_resolution_clock::now().time_since_epoch());
+
+	auto key = TestHistory::KeyOf(*context.Definition->_parent);
+	Request request{ timeout.count(), context.Instances.Begin, context.Instances.End, (uint32_t)key.size() };
+	std::string message(reinterpret_cast<const char*>(&request), sizeof(request));
+	message += key;
+	if (!SendAll(worker.Socket, message.data(), message.size()))
+		return Outcome::Lost;
+
+	// clear out any wake up left over from a cancellation that came in after its test finished
+	char drain[16];
+	while (read(worker.Wakeup[0], drain, sizeof(drain)) > 0) {}
+
+	std::stop_callback onCancel(token, [fd = worker.Wakeup[1]]()
+	{
+		char wake = 0;
+		(void)!write(fd, &wake, 1);
+	});
+
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (true)
+	{
+		auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		if (remaining.count() <= 0)
+		{
+			context.SetFailure(std::format("exceeded timeout duration of {}", timeout));
+			return Outcome::Expired;
+		}
+
+		pollfd descriptors[2] = { { worker.Socket, POLLIN, 0 }, { worker.Wakeup[0], POLLIN, 0 } };
+		int ready = poll(descriptors, 2, (int)remaining.count());
+		if (ready <= 0)
+			continue; // interrupted or timed out, either way the deadline is checked above
+
+		if (descriptors[0].revents != 0)
+			break;
+
+		if (descriptors[1].revents != 0)
+		{
+			context.SetFailure("cancelled");
+			return Outcome::Cancelled;
+		}
+	}
+
+	if (!ReceiveResult(worker.Socket, *context.Result))
+		return Outcome::Lost;
+
+	return Outcome::Completed;
+}
+
+std::unique_ptr<TestProcessPool::Worker> TestProcessPool::Acquire()
+{
+	std::lock_guard lock(_mutex);
+	if (_idle.empty())
+		return Spawn();
+
+	auto worker = std::move(_idle.back());
+	_idle.pop_back();
+	return worker;
+}
+
+void TestProcessPool::Release(std::unique_ptr<Worker> worker)
+{
+	std::lock_guard lock(_mutex);
+	_idle.push_back(std::move(worker));
+}
+
+void TestProcessPool::Replace(std::unique_ptr<Worker> worker, int* exitStatus)
+{
+	std::lock_guard lock(_mutex);
+	Kill(*worker, exitStatus);
+	--_numWorkers;
+
+	++_numRespawned;
+	if (auto fresh = Spawn())
+		_idle.push_back(std::move(fresh));
+}
+
+// Must be called with the mutex held
+std::unique_ptr<TestProcessPool::Worker> TestProcessPool::Spawn()
+{
+	auto worker = std::make_unique<Worker>();
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+		return nullptr;
+
+	if (pipe2(worker->Wakeup, O_CLOEXEC | O_NONBLOCK) != 0)
+	{
+		close(sockets[0]);
+		close(sockets[1]);
+		return nullptr;
+	}
+
+	// the worker only gets its own end of the socket
+	int pid = TestForkServer::Spawn(TestForkServer::Role::Worker, sockets[1]);
+	close(sockets[1]);
+	if (pid < 0)
+	{
+		close(sockets[0]);
+		close(worker->Wakeup[0]);
+		close(worker->Wakeup[1]);
+		return nullptr;
+	}
+
+	worker->Pid = pid;
+	worker->Socket = sockets[0];
+	++_numWorkers;
+	return worker;
+}
+
+std::unique_ptr<TestProcessPool::Worker> TestProcessPool::ForkFromZygote(const std::string& key)
+{
+	if (!StartZygote())
+		return nullptr;
+
+	auto worker = std::make_unique<Worker>();
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+		return nullptr;
+
+	if (pipe2(worker->Wakeup, O_CLOEXEC | O_NONBLOCK) != 0)
+	{
+		close(sockets[0]);
+		close(sockets[1]);
+		return nullptr;
+	}
+
+	int32_t pid = -1;
+	{
+		std::lock_guard zygoteLock(_zygoteMutex);
+
+		ZygoteRequest request{ ZygoteRequest::Fork, 0, (uint32_t)key.size() };
+		if (SendWithDescriptor(_zygoteControl, &request, sizeof(request), sockets[1]) && SendAll(_zygoteControl, key.data(), key.size()))
+			ReceiveAll(_zygoteControl, &pid, sizeof(pid));
+	}
+
+	// the test process has its own copy now
+	close(sockets[1]);
+	if (pid <= 0)
+	{
+		close(sockets[0]);
+		close(worker->Wakeup[0]);
+		close(worker->Wakeup[1]);
+		return nullptr;
+	}
+
+	worker->Pid = pid;
+	worker->Socket = sockets[0];
+
+	std::lock_guard lock(_mutex);
+	++_numForked;
+	return worker;
+}
+
+// Must be called with the mutex held
+void TestProcessPool::Kill(Worker& worker, int* exitStatus)
+{
+	if (worker.Pid < 0)
+		return;
+
+	// the workers are the server's children, so it's the one that has to wait on them
+	kill(worker.Pid, SIGKILL);
+	int status = TestForkServer::Reap(worker.Pid);
+	if (exitStatus)
+		*exitStatus = status;
+
+	Close(worker);
+}
+
+// Test processes belong to the zygote, so it's the one that has to wait on them
+int TestProcessPool::Reap(Worker& worker)
+{
+	int32_t status = 0;
+	kill(worker.Pid, SIGKILL);
+	{
+		std::lock_guard zygoteLock(_zygoteMutex);
+
+		ZygoteRequest request{ ZygoteRequest::Reap, worker.Pid, 0 };
+		if (SendAll(_zygoteControl, &request, sizeof(request)))
+			ReceiveAll(_zygoteControl, &status, sizeof(status));
+	}
+
+	std::lock_guard lock(_mutex);
+	Close(worker);
+	return status;
+}
+
+void TestProcessPool::Close(Worker& worker)
+{
+	for (int descriptor : { worker.Socket, worker.Wakeup[0], worker.Wakeup[1] })
+	{
+		if (descriptor >= 0)
+			close(descriptor);
+	}
+
+	worker.Pid = -1;
+}
+
+void TestProcessPool::StopZygote()
+{
+	std::lock_guard zygoteLock(_zygoteMutex);
+	if (_zygotePid < 0)
+		return;
+
+	Worker zygote{ _zygotePid, _zygoteControl };
+	std::lock_guard lock(_mutex);
+	Kill(zygote);
+	_zygotePid = _zygoteControl = -1;
+}
+
+void TestProcessPool::Serve(int socket)
+{
+	while (true)
+	{
+		Request request;
+		if (!ReceiveAll(socket, &request, sizeof(request)))
+			_exit(0);
+
+		std::string key(request.KeyLength, '\0');
+		if (!ReceiveAll(socket, key.data(), key.size()))
+			_exit(0);
+
+		TestResult result;
+		TestForkServer::Run(key, { request.Begin, request.End }, std::chrono::milliseconds(request.Timeout), result);
+		if (!SendResult(socket, result))
+			_exit(0);
+	}
+}
+
+void TestProcessPool::ServeZygote(int control)
+{
+	while (true)
+	{
+		ZygoteRequest request;
+		int descriptor = -1;
+		if (!ReceiveWithDescriptor(control, &request, sizeof(request), descriptor))
+			_exit(0);
+
+		std::string key(request.KeyLength, '\0');
+		if (!ReceiveAll(control, key.data(), key.size()))
+			_exit(0);
+
+		int32_t reply = -1;
+		if (request.Type == ZygoteRequest::Fork && descriptor >= 0)
+		{
+			// any instances are created here, so the tests forked after this one don't create them again
+			TestForkServer::Find(key);
+
+			pid_t pid = fork();
+			if (pid == 0)
+			{
+				// take the test down with us if the zygote goes away
+				prctl(PR_SET_PDEATHSIG, SIGKILL);
+				close(control);
+				Serve(descriptor);
+			}
+
+			close(descriptor);
+			reply = pid;
+		}
+		else if (request.Type == ZygoteRequest::Reap)
+		{
+			int status = 0;
+			while (waitpid(request.Pid, &status, 0) < 0 && errno == EINTR) {}
+			reply = status;
+		}
+
+		if (!SendAll(control, &reply, sizeof(reply)))
+			_exit(0);
+	}
+}
+
+#else
+
+bool TestProcessPool::IsSupported()
+{
+	return false;
+}
+
+TestProcessPool::~TestProcessPool() = default;
+
+void TestProcessPool::Reserve(size_t numWorkers) {}
+
+void TestProcessPool::Run(TestContext& context, std::chrono::milliseconds timeout, std::stop_token token)
+{
+	context.Result->Reset();
+	context.SetFailure("process isolation is not supported on this platform");
+}
+
+void TestProcessPool::RunForked(TestContext& context, std::chrono::milliseconds timeout, std::stop_token token)
+{
+	Run(context, timeout, token);
+}
+
+bool TestProcessPool::StartZygote() { return false; }
+
+size_t TestProcessPool::NumWorkers() const { return 0; }
+size_t TestProcessPool::NumRespawned() const { return 0; }
+size_t TestProcessPool::NumForked() const { return 0; }
+
+#endif
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace lsn::test_framework
+{
+	struct TestContext;
+
+	// A pool of pre-forked worker processes that tests are sent to one at a time.
+	// A test that hangs or crashes only takes its worker down with it, the worker is killed
+	// and a fresh one is forked in its place. Results are streamed back over a unix socket.
+	//
+	// Alternatively tests can be forked one at a time from a zygote, a process forked once that has
+	// run the initializers and then does nothing but fork, so every test starts from the same pristine image.
+	// Every process is forked by the TestForkServer, so only registered tests can be run in them.
+	struct TestProcessPool
+	{
+		static bool IsSupported();
+
+		TestProcessPool() = default;
+		TestProcessPool(const TestProcessPool&) = delete;
+		~TestProcessPool();
+
+		// Forks workers up front so that the first tests don't pay for it
+		void Reserve(size_t numWorkers);
+
+		// Blocks until the test has finished, exceeded its timeout or been cancelled
+		void Run(TestContext& context, std::chrono::milliseconds timeout, std::stop_token token);
+
+		// As Run, but the test gets a process of its own forked from the zygote
+		void RunForked(TestContext& context, std::chrono::milliseconds timeout, std::stop_token token);
+
+		bool StartZygote();
+
+		size_t NumWorkers() const;
+		size_t NumRespawned() const;
+		size_t NumForked() const;
+
+	private:
+		struct Worker
+		{
+			int Pid = -1;
+			int Socket = -1;
+			int Wakeup[2] = { -1, -1 }; // used to interrupt the wait on cancellation
+		};
+
+		enum class Outcome
+		{
+			Completed,
+			Expired,
+			Cancelled,
+			Lost, // the worker died before reporting back
+		};
+
+		Outcome Execute(Worker& worker, TestContext& context, std::chrono::milliseconds timeout, std::stop_token token);
+
+		std::unique_ptr<Worker> Acquire();
+		void Release(std::unique_ptr<Worker> worker);
+		void Replace(std::unique_ptr<Worker> worker, int* exitStatus);
+
+		std::unique_ptr<Worker> Spawn();
+		std::unique_ptr<Worker> ForkFromZygote(const std::string& key);
+		void Kill(Worker& worker, int* exitStatus = nullptr);
+		int Reap(Worker& worker);
+		void Close(Worker& worker);
+		void StopZygote();
+
+		// The loop a forked worker runs until its socket is closed
+		friend struct TestForkServer;
+		[[noreturn]] static void Serve(int socket);
+		[[noreturn]] static void ServeZygote(int control);
+
+		mutable std::mutex _mutex;
+		std::vector<std::unique_ptr<Worker>> _idle;
+		size_t _numWorkers = 0;
+		size_t _numRespawned = 0;
+		size_t _numForked = 0;
+
+		// requests to the zygote are serialized, it only ever forks or reaps
+		std::mutex _zygoteMutex;
+		int _zygotePid = -1;
+		int _zygoteControl = -1;
+	};
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Generators of random arguments for property tests. Each creates a value from a random engine and, once a property
+// has been falsified, lists simpler values to try in its place, simplest first.
+namespace lsn::test_framework::properties
+{
+	using Random = std::mt19937_64;
+
+	template<typename Generator>
+	concept ValueGenerator = requires(const Generator& generator, Random& random, const typename Generator::value_type& value)
+	{
+		{ generator(random) } -> std::convertible_to<typename Generator::value_type>;
+		{ generator.Shrink(value) } -> std::convertible_to<std::vector<typename Generator::value_type>>;
+	};
+
+	// min to max inclusive, shrinking towards whichever end is closest to zero
+	template<std::integral T>
+	class IntegerGenerator
+	{
+	public:
+		using value_type = T;
+
+		IntegerGenerator(T min, T max)
+			: _min(min), _max(max)
+		{}
+
+		T operator()(Random& random) const
+		{
+			// uniform_int_distribution doesn't take the character types
+			using Wide = std::conditional_t<std::is_signed_v<T>, long long, unsigned long long>;
+			return static_cast<T>(std::uniform_int_distribution<Wide>(_min, _max)(random));
+		}
+
+		std::vector<T> Shrink(T value) const
+		{
+			const T target = std::clamp(T(0), _min, _max);
+			if (value == target)
+				return {};
+
+			// the target, then ever closer to the value by halving the distance. Done in unsigned arithmetic as
+			// the distance between the ends of a signed type doesn't fit in it.
+			using Unsigned = std::make_unsigned_t<std::conditional_t<std::is_same_v<T, bool>, unsigned char, T>>;
+			const bool above = value > target;
+			const Unsigned distance = above ? Unsigned(Unsigned(value) - Unsigned(target)) : Unsigned(Unsigned(target) - Unsigned(value));
+
+			std::vector<T> candidates{ target };
+			for (Unsigned step = distance / 2; step > 0; step /= 2)
+				candidates.push_back(static_cast<T>(above ? Unsigned(Unsigned(value) - step) : Unsigned(Unsigned(value) + step)));
+			return candidates;
+		}
+
+	private:
+		T _min;
+		T _max;
+	};
+
+	template<std::floating_point T>
+	class RealGenerator
+	{
+	public:
+		using value_type = T;
+
+		RealGenerator(T min, T max)
+			: _min(min), _max(max)
+		{}
+
+		T operator()(Random& random) const { return std::uniform_real_distribution<T>(_min, _max)(random); }
+
+		std::vector<T> Shrink(T value) const
+		{
+			const T target = std::clamp(T(0), _min, _max);
+			if (value == target || std::isnan(value))
+				return {};
+
+			std::vector<T> candidates{ target };
+			if (T whole = std::trunc(value); whole != value && whole >= _min && whole <= _max)
+				candidates.push_back(whole);
+			if (T half = target + (value - target) / 2; half != value && half != target)
+				candidates.push_back(half);
+			return candidates;
+		}
+
+	private:
+		T _min;
+		T _max;
+	};
+
+	class BooleanGenerator
+	{
+	public:
+		using value_type = bool;
+
+		bool operator()(Random& random) const { return std::bernoulli_distribution()(random); }
+		std::vector<bool> Shrink(bool value) const { return value ? std::vector<bool>{ false } : std::vector<bool>{}; }
+	};
+
+	// One of a fixed set of values, shrinking towards those listed first
+	template<std::equality_comparable T>
+	class ElementGenerator
+	{
+	public:
+		using value_type = T;
+
+		explicit ElementGenerator(std::vector<T> elements)
+			: _elements(std::move(elements))
+		{}
+
+		T operator()(Random& random) const
+		{
+			return _elements[std::uniform_int_distribution<size_t>(0, _elements.size() - 1)(random)];
+		}
+
+		std::vector<T> Shrink(const T& value) const
+		{
+			auto it = std::find(_elements.begin(), _elements.end(), value);
+			return std::vector<T>(_elements.begin(), it);
+		}
+
+	private:
+		std::vector<T> _elements;
+	};
+
+	// Up to maxSize elements, shrinking by dropping elements before simplifying those that are left
+	template<ValueGenerator Element>
+	class VectorGenerator
+	{
+	public:
+		using value_type = std::vector<typename Element::value_type>;
+
+		VectorGenerator(Element element, size_t maxSize)
+			: _element(std::move(element)), _maxSize(maxSize)
+		{}
+
+		value_type operator()(Random& random) const
+		{
+			value_type values(std::uniform_int_distribution<size_t>(0, _maxSize)(random));
+			for (auto& value : values)
+				value = _element(random);
+			return values;
+		}
+
+		std::vector<value_type> Shrink(const value_type& values) const
+		{
+			std::vector<value_type> candidates;
+			if (values.empty())
+				return candidates;
+
+			candidates.emplace_back();
+			if (values.size() > 2)
+			{
+				candidates.emplace_back(values.begin(), values.begin() + values.size() / 2);
+				candidates.emplace_back(values.begin() + values.size() / 2, values.end());
+			}
+
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				auto& without = candidates.emplace_back(values);
+				without.erase(without.begin() + i);
+			}
+
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				for (auto&& simpler : _element.Shrink(values[i]))
+				{
+					auto& candidate = candidates.emplace_back(values);
+					candidate[i] = std::move(simpler);
+				}
+			}
+
+			return candidates;
+		}
+
+	private:
+		Element _element;
+		size_t _maxSize;
+	};
+
+	// The arguments of a property, shrunk one argument at a time
+	template<ValueGenerator... Generators>
+	class ForAllGenerator
+	{
+	public:
+		using value_type = std::tuple<typename Generators::value_type...>;
+
+		explicit ForAllGenerator(Generators... generators)
+			: _generators(std::move(generators)...)
+		{}
+
+		value_type operator()(Random& random) const
+		{
+			// braced initialization is evaluated left to right, so the arguments are the same for every compiler
+			return std::apply([&random](const auto&... generators) { return value_type{ generators(random)... }; }, _generators);
+		}
+
+		std::vector<value_type> Shrink(const value_type& values) const
+		{
+			std::vector<value_type> candidates;
+			ShrinkEach(values, candidates, std::index_sequence_for<Generators...>());
+			return candidates;
+		}
+
+	private:
+		template<size_t... I>
+		void ShrinkEach(const value_type& values, std::vector<value_type>& candidates, std::index_sequence<I...>) const
+		{
+			(..., ShrinkArgument<I>(values, candidates));
+		}
+
+		template<size_t I>
+		void ShrinkArgument(const value_type& values, std::vector<value_type>& candidates) const
+		{
+			for (auto&& simpler : std::get<I>(_generators).Shrink(std::get<I>(values)))
+			{
+				auto& candidate = candidates.emplace_back(values);
+				std::get<I>(candidate) = std::move(simpler);
+			}
+		}
+
+		std::tuple<Generators...> _generators;
+	};
+
+	// A property's generators with the argument types of the test erased, as stored by its TestGenerator
+	template<typename Arguments>
+	struct Property
+	{
+		std::function<Arguments(Random&)> Generate;
+		std::function<std::vector<Arguments>(const Arguments&)> Shrink;
+	};
+
+	constexpr size_t DefaultTrials = 1000;
+	// each instance of a property runs this many of its trials, so they're spread over the workers
+	constexpr size_t TrialsPerInstance = 100;
+	// a counterexample is only simplified so far, in case shrinking never settles
+	constexpr size_t MaxShrinks = 1000;
+
+	// Trials are seeded by the property's name and their number, so a counterexample is found again on every run
+	constexpr uint64_t SeedFor(std::string_view name, uint64_t trial)
+	{
+		uint64_t seed = 14695981039346656037ull;
+		for (char c : name)
+			seed = (seed ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+
+		// splitmix64, so neighbouring trials get unrelated seeds
+		seed += (trial + 1) * 0x9e3779b97f4a7c15ull;
+		seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ull;
+		seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebull;
+		return seed ^ (seed >> 31);
+	}
+
+	template<std::integral T>
+	auto Integers(T min = std::numeric_limits<T>::min(), T max = std::numeric_limits<T>::max())
+	{
+		return IntegerGenerator<T>(min, max);
+	}
+
+	template<std::floating_point T>
+	auto Reals(T min, T max)
+	{
+		return RealGenerator<T>(min, max);
+	}
+
+	inline auto Booleans()
+	{
+		return BooleanGenerator();
+	}
+
+	template<typename T, typename... Ts>
+	auto Elements(T first, Ts... rest)
+	{
+		return ElementGenerator<T>(std::vector<T>{ first, static_cast<T>(rest)... });
+	}
+
+	template<ValueGenerator Element>
+	auto Vectors(Element element, size_t maxSize = 16)
+	{
+		return VectorGenerator<Element>(std::move(element), maxSize);
+	}
+
+	template<ValueGenerator... Generators>
+	auto ForAll(Generators... generators)
+	{
+		return ForAllGenerator<Generators...>(std::move(generators)...);
+	}
+}
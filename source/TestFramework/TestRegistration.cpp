@@ -0,0 +1,159 @@
+#include "TestRegistration.h"
+
+#include "TestObject.h"
+
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace lsn::test_framework
+{
+
+#if defined _MSC_VER
+
+// Sections are merged in the order of the name after the $, so these bookend the entries in $m
+#pragma section("elcat$a", read)
+#pragma section("elcat$z", read)
+#pragma section("eltst$a", read)
+#pragma section("eltst$z", read)
+
+__declspec(allocate("elcat$a")) extern const TestCategoryRegistration* const CategoriesBegin = nullptr;
+__declspec(allocate("elcat$z")) extern const TestCategoryRegistration* const CategoriesEnd = nullptr;
+__declspec(allocate("eltst$a")) extern const TestRegistration* const TestsBegin = nullptr;
+__declspec(allocate("eltst$z")) extern const TestRegistration* const TestsEnd = nullptr;
+
+std::span<const TestCategoryRegistration* const> RegisteredCategories()
+{
+	return { &CategoriesBegin + 1, &CategoriesEnd };
+}
+
+std::span<const TestRegistration* const> RegisteredTests()
+{
+	return { &TestsBegin + 1, &TestsEnd };
+}
+
+#else
+
+// Provided by the linker for any section named as an identifier, weak so a binary without tests still links
+extern "C"
+{
+	[[gnu::weak]] extern const TestCategoryRegistration* const __start_elision_categories[];
+	[[gnu::weak]] extern const TestCategoryRegistration* const __stop_elision_categories[];
+	[[gnu::weak]] extern const TestRegistration* const __start_elision_tests[];
+	[[gnu::weak]] extern const TestRegistration* const __stop_elision_tests[];
+}
+
+std::span<const TestCategoryRegistration* const> RegisteredCategories()
+{
+	if (!__start_elision_categories)
+		return {};
+	return { __start_elision_categories, __stop_elision_categories };
+}
+
+std::span<const TestRegistration* const> RegisteredTests()
+{
+	if (!__start_elision_tests)
+		return {};
+	return { __start_elision_tests, __stop_elision_tests };
+}
+
+#endif
+
+namespace
+{
+	// Each translation unit's records are kept together in the order the files were linked, as they were when
+	// they registered themselves while statically initialized. Within a file the compiler may have emitted them in
+	// any order, so they're put back into the order they were declared.
+	template<typename Record>
+	std::vector<const Record*> InDeclarationOrder(std::span<const Record* const> records)
+	{
+		std::vector<const Record*> ordered;
+		std::unordered_map<std::string_view, size_t> files; // where each file's records start in the section
+		ordered.reserve(records.size());
+		for (const auto* record : records)
+		{
+			if (!record)
+				continue;
+
+			files.try_emplace(record->File, files.size());
+			ordered.push_back(record);
+		}
+
+		std::stable_sort(ordered.begin(), ordered.end(), [&files](const Record* lhs, const Record* rhs)
+		{
+			return std::tuple(files.at(lhs->File), lhs->LineNumber) < std::tuple(files.at(rhs->File), rhs->LineNumber);
+		});
+
+		return ordered;
+	}
+}
+
+void BuildTestTree(std::span<const TestCategoryRegistration* const> categories, std::span<const TestRegistration* const> tests, std::deque<TestObject>& roots)
+{
+	std::unordered_map<const TestCategoryRegistration*, TestObject*> objects;
+
+	// parents first, wherever they were declared
+	auto objectOf = [&](auto& self, const TestCategoryRegistration* category) -> TestObject*
+	{
+		if (auto it = objects.find(category); it != objects.end())
+			return it->second;
+
+		TestObject* object = nullptr;
+		if (category->Parent)
+			object = self(self, category->Parent)->Add(std::make_unique<TestObject>(std::string(category->Name)));
+		else
+			object = &roots.emplace_back(std::string(category->Name));
+
+		object->File = category->File;
+		object->LineNumber = category->LineNumber;
+		objects[category] = object;
+		return object;
+	};
+
+	for (const auto* category : InDeclarationOrder(categories))
+		objectOf(objectOf, category);
+
+	for (const auto* test : InDeclarationOrder(tests))
+	{
+		auto* category = objectOf(objectOf, test->Category);
+		if (test->Initialize)
+			category->Initialize = test->Initialize;
+		else
+			category->Add(test->Generate());
+	}
+}
+
+TestObject* FindTest(std::deque<TestObject>& roots, std::string_view key)
+{
+	// names can contain a '/' themselves, so each child whose name fits is tried in turn
+	auto below = [](auto& self, TestObject& object, std::string_view path) -> TestObject*
+	{
+		if (!path.starts_with(object.Name))
+			return nullptr;
+
+		path.remove_prefix(object.Name.size());
+		if (path.empty())
+			return &object;
+		if (path.front() != '/')
+			return nullptr;
+
+		path.remove_prefix(1);
+		object.Expand();
+		for (auto& child : object.Children)
+		{
+			if (auto* found = self(self, *child, path))
+				return found;
+		}
+		return nullptr;
+	};
+
+	for (auto& root : roots)
+	{
+		if (auto* found = below(below, root, key))
+			return found;
+	}
+	return nullptr;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace lsn::test_framework
+{
+	struct TestObject;
+
+	// A category as declared by DeclareTestCategory/DeclareTestSubCategory
+	struct TestCategoryRegistration
+	{
+		std::string_view Name;
+		const TestCategoryRegistration* Parent = nullptr;
+		std::string_view File;
+		int LineNumber = 0;
+	};
+
+	// A test as declared by DeclareTest, just enough to build its part of the tree once it's first needed.
+	// One declared by DeclareTestInitializer has no test, only the initializer of its category.
+	struct TestRegistration
+	{
+		const TestCategoryRegistration* Category = nullptr;
+		std::string_view File;
+		int LineNumber = 0;
+		std::unique_ptr<TestObject>(*Generate)() = nullptr;
+		void(*Initialize)() = nullptr;
+	};
+
+	// so declaring a test never runs any code before main
+	static_assert(std::is_trivially_destructible_v<TestRegistration> && std::is_trivially_destructible_v<TestCategoryRegistration>);
+
+	// Every record placed in the registration sections by the declaration macros. There can be gaps in the
+	// sections, so either can contain null entries.
+	std::span<const TestCategoryRegistration* const> RegisteredCategories();
+	std::span<const TestRegistration* const> RegisteredTests();
+
+	// Creates the objects of every category and test, in declaration order. Top level categories are appended to roots.
+	void BuildTestTree(std::span<const TestCategoryRegistration* const> categories, std::span<const TestRegistration* const> tests, std::deque<TestObject>& roots);
+
+	// The object at the path TestHistory::KeyOf gives, creating the instances of any parameterized test on the way
+	TestObject* FindTest(std::deque<TestObject>& roots, std::string_view key);
+}
+
+// The declaration macros only emit constant data, so declaring a test costs nothing until the tree is built.
+// A pointer to each record goes into a section of its own, which the linker gathers into one array.
+#if defined _MSC_VER
+	#pragma section("elcat$m", read)
+	#pragma section("eltst$m", read)
+	#define ImplementTestRegistrationEntry(section_name, type, name, record) __declspec(allocate(section_name)) extern const type* const name = &record;
+	#define RegisterTestCategory(name, record) ImplementTestRegistrationEntry("elcat$m", lsn::test_framework::TestCategoryRegistration, name, record)
+	#define RegisterTest(name, record) ImplementTestRegistrationEntry("eltst$m", lsn::test_framework::TestRegistration, name, record)
+#else
+	#define ImplementTestRegistrationEntry(section_name, type, name, record) [[gnu::used, gnu::section(section_name)]] static const type* const name = &record;
+	#define RegisterTestCategory(name, record) ImplementTestRegistrationEntry("elision_categories", lsn::test_framework::TestCategoryRegistration, name, record)
+	#define RegisterTest(name, record) ImplementTestRegistrationEntry("elision_tests", lsn::test_framework::TestRegistration, name, record)
+#endif
@@ -0,0 +1,51 @@
+#include "TestRegistry.h"
+
+#include "TestObject.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace lsn::test_framework
+{
+
+void TestRegistry::Add(TestObject& root)
+{
+	const auto first = (uint32_t)Size();
+
+	// an explicit stack, as parameterized tests can make the tree deep as well as wide
+	std::vector<std::pair<TestObject*, uint32_t>> pending{ { &root, NoParent } };
+	while (!pending.empty())
+	{
+		auto [object, parent] = pending.back();
+		pending.pop_back();
+
+		uint8_t flags = 0;
+		flags |= object->Definition ? IsTest : 0;
+		flags |= parent == NoParent ? IsRoot : 0;
+		flags |= object->Initialize ? HasInitialize : 0;
+		flags |= object->TearDown ? HasTearDown : 0;
+		flags |= object->IsPending() ? IsPending : 0;
+
+		object->Node = (uint32_t)Size();
+		_parents.push_back(parent);
+		_subtreeEnds.push_back(object->Node + 1);
+		_flags.push_back(flags);
+		_names.push_back(object->Name);
+		_definitions.push_back(object->Definition.get());
+		_objects.push_back(object);
+		_numTests += object->Definition ? 1 : 0;
+
+		// reversed, so the first child is the next to be visited
+		for (auto it = object->Children.rbegin(); it != object->Children.rend(); ++it)
+			pending.emplace_back(it->get(), object->Node);
+	}
+
+	// children always follow their parent, so walking backwards has every subtree complete before its parent takes it
+	for (auto node = (uint32_t)Size(); node-- > first; )
+	{
+		if (_parents[node] != NoParent)
+			_subtreeEnds[_parents[node]] = std::max(_subtreeEnds[_parents[node]], _subtreeEnds[node]);
+	}
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lsn::test_framework
+{
+	struct TestObject;
+	struct TestDefinition;
+
+	// The test tree flattened into parallel arrays in pre-order, so the subtree of a node is the run of nodes that
+	// follows it up to its SubtreeEnd. Whole suite operations become linear scans of the columns they need rather than
+	// a walk through the individually allocated tree. The tree still owns everything, the registry only indexes it.
+	class TestRegistry
+	{
+	public:
+		static constexpr uint32_t NoParent = ~0u;
+
+		enum NodeFlags : uint8_t
+		{
+			IsTest = 1 << 0,
+			IsRoot = 1 << 1,
+			HasInitialize = 1 << 2,
+			HasTearDown = 1 << 3,
+			IsPending = 1 << 4, // a parameterized test that hasn't been expanded
+		};
+
+		// Appends the root and everything below it, recording where each object landed in TestObject::Node
+		void Add(TestObject& root);
+
+		size_t Size() const { return _objects.size(); }
+		size_t NumTests() const { return _numTests; }
+
+		uint32_t Parent(uint32_t node) const { return _parents[node]; }
+		uint32_t SubtreeEnd(uint32_t node) const { return _subtreeEnds[node]; }
+		uint8_t Flags(uint32_t node) const { return _flags[node]; }
+		std::string_view Name(uint32_t node) const { return _names[node]; }
+		const TestObject& Object(uint32_t node) const { return *_objects[node]; }
+		const TestDefinition* Definition(uint32_t node) const { return _definitions[node]; }
+
+		// Calls func(const TestDefinition*) for every test, in registration order
+		template<typename Func>
+		void ForEachTest(Func&& func) const
+		{
+			ForEachTestBetween(0, (uint32_t)Size(), func);
+		}
+
+		// Calls func(const TestDefinition*) for every test at or below the node
+		template<typename Func>
+		void ForEachTestIn(uint32_t node, Func&& func) const
+		{
+			ForEachTestBetween(node, _subtreeEnds[node], func);
+		}
+
+	private:
+		template<typename Func>
+		void ForEachTestBetween(uint32_t begin, uint32_t end, Func& func) const
+		{
+			for (uint32_t node = begin; node < end; ++node)
+			{
+				if (_flags[node] & IsTest)
+					func(_definitions[node]);
+			}
+		}
+
+		std::vector<uint32_t> _parents;
+		std::vector<uint32_t> _subtreeEnds;
+		std::vector<uint8_t> _flags;
+		std::vector<std::string_view> _names;
+		std::vector<const TestDefinition*> _definitions;
+		std::vector<const TestObject*> _objects;
+		size_t _numTests = 0;
+	};
+}
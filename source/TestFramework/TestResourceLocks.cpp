@@ -0,0 +1,188 @@
+#include "TestResourceLocks.h"
+
+#include "TestRunner.h"
+#include "TestDefinition.h"
+#include "TestRunState.h"
+
+#include <algorithm>
+#include <format>
+
+namespace lsn::test_framework
+{
+
+bool TestResourceLocks::TryAcquire(const TestDefinition& test)
+{
+	if (test.Resources.empty())
+		return true;
+
+	std::lock_guard lock(_mutex);
+	return TryAcquireLocked(test);
+}
+
+bool TestResourceLocks::Acquire(TestContext& test, std::stop_token token)
+{
+	if (test.Definition->Resources.empty())
+		return true;
+
+	std::unique_lock lock(_mutex);
+	bool stranded = false;
+	bool acquired = _released.wait(lock, token, [&]()
+	{
+		if (TryAcquireLocked(*test.Definition))
+			return true;
+		stranded = StrandLocked(test);
+		return stranded;
+	});
+
+	return acquired && !stranded;
+}
+
+void TestResourceLocks::Release(const TestDefinition& test)
+{
+	Release(test.Resources, false);
+}
+
+void TestResourceLocks::ReleaseOnExit(const TestDefinition& test, const TestExecutor::JobHandle& job)
+{
+	if (test.Resources.empty())
+		return;
+
+	{
+		std::lock_guard lock(_mutex);
+		for (const auto& resource : test.Resources)
+			_usage[resource.Name].Abandoned++;
+	}
+
+	// those that were waiting on them may now be stranded
+	_released.notify_all();
+
+	// the resources are copied, the test may well be gone by the time the job returns
+	job->Then([self = shared_from_this(), resources = test.Resources]() { self->Release(resources, true); });
+}
+
+void TestResourceLocks::Release(const std::vector<TestResource>& resources, bool abandoned)
+{
+	if (resources.empty())
+		return;
+
+	{
+		std::lock_guard lock(_mutex);
+		for (const auto& resource : resources)
+		{
+			auto& usage = _usage[resource.Name];
+			usage.Used--;
+			usage.Abandoned -= abandoned ? 1 : 0;
+		}
+
+		// under the lock, so once it's been replaced it's never called again
+		if (_onReleased)
+			_onReleased();
+	}
+	_released.notify_all();
+}
+
+bool TestResourceLocks::Strand(TestContext& test)
+{
+	std::lock_guard lock(_mutex);
+	return StrandLocked(test);
+}
+
+void TestResourceLocks::OnReleased(std::function<void()> callback)
+{
+	std::lock_guard lock(_mutex);
+	_onReleased = std::move(callback);
+}
+
+void TestResourceLocks::OnStranded(std::function<void(TestContext&)> callback)
+{
+	std::lock_guard lock(_mutex);
+	_onStranded = std::move(callback);
+}
+
+void TestResourceLocks::Defer(TestContext* test)
+{
+	{
+		std::lock_guard lock(_mutex);
+		_deferred.push_back(test);
+	}
+	// a worker may already be waiting for deferred tests to show up
+	_released.notify_all();
+}
+
+std::optional<TestContext*> TestResourceLocks::TryTakeDeferred()
+{
+	std::lock_guard lock(_mutex);
+	return TakeDeferredLocked();
+}
+
+std::optional<TestContext*> TestResourceLocks::TakeDeferred(std::stop_token token)
+{
+	std::unique_lock lock(_mutex);
+
+	std::optional<TestContext*> next;
+	_released.wait(lock, token, [&]()
+	{
+		next = TakeDeferredLocked();
+		return next || _deferred.empty();
+	});
+
+	return next;
+}
+
+bool TestResourceLocks::TryAcquireLocked(const TestDefinition& test)
+{
+	// Conflicting capacities for the same resource settle on the most restrictive
+	for (const auto& resource : test.Resources)
+	{
+		auto [it, inserted] = _usage.try_emplace(resource.Name, Usage{ 0, resource.Capacity });
+		auto& usage = it->second;
+		usage.Capacity = std::min(usage.Capacity, resource.Capacity);
+
+		if (usage.Used >= usage.Capacity)
+			return false;
+	}
+
+	for (const auto& resource : test.Resources)
+		_usage[resource.Name].Used++;
+
+	return true;
+}
+
+bool TestResourceLocks::StrandLocked(TestContext& test)
+{
+	for (const auto& resource : test.Definition->Resources)
+	{
+		auto it = _usage.find(resource.Name);
+		if (it == _usage.end() || it->second.Used < it->second.Capacity || it->second.Abandoned < it->second.Used)
+			continue;
+
+		test.SetFailure(std::format("needs {}, which is still held by a test that was abandoned", resource.Name));
+		if (_onStranded)
+			_onStranded(test);
+		else
+			TestRunState::Settle(*test.Definition, *test.Result);
+		return true;
+	}
+
+	return false;
+}
+
+std::optional<TestContext*> TestResourceLocks::TakeDeferredLocked()
+{
+	// oldest first, so a test isn't starved by the ones deferred after it. Stranded tests are failed on the way.
+	for (auto it = _deferred.begin(); it != _deferred.end(); )
+	{
+		auto* test = *it;
+		if (TryAcquireLocked(*test->Definition))
+		{
+			_deferred.erase(it);
+			return test;
+		}
+
+		it = StrandLocked(*test) ? _deferred.erase(it) : it + 1;
+	}
+
+	return std::nullopt;
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TestExecutor.h"
+
+namespace lsn::test_framework
+{
+	struct TestContext;
+	struct TestDefinition;
+	struct TestResource;
+
+	// Tracks which named resources are held by running tests for the duration of a session.
+	// A test takes every resource it uses or none of them, so tests can't deadlock on each other.
+	// Tests that can't run yet are deferred here until a running test releases what they need.
+	// A test abandoned while still running keeps its resources until it exits, so it's held by a shared_ptr.
+	// Whoever needs one held only by abandoned tests fails rather than wait on something that may never return.
+	class TestResourceLocks : public std::enable_shared_from_this<TestResourceLocks>
+	{
+	public:
+		bool TryAcquire(const TestDefinition& test);
+		// Blocks until the resources are available. Returns false if cancelled first, or if the test was failed
+		// for wanting a resource only abandoned tests hold.
+		bool Acquire(TestContext& test, std::stop_token token);
+		void Release(const TestDefinition& test);
+		// Releases the resources of a test once its abandoned job has actually returned
+		void ReleaseOnExit(const TestDefinition& test, const TestExecutor::JobHandle& job);
+		// Fails the test if a resource it needs is all held by abandoned tests, true if it did
+		bool Strand(TestContext& test);
+
+		// Called whenever anything is released, for whoever waits on more than these locks. It's called under the
+		// lock, so it mustn't block or call back in. Empty to stop.
+		void OnReleased(std::function<void()> callback);
+		// Called with each test that's failed for want of a resource, again under the lock. Without one the test
+		// is only settled, there being no session to finish it in.
+		void OnStranded(std::function<void(TestContext&)> callback);
+
+		void Defer(TestContext* test);
+
+		// A deferred test whose resources have now been acquired, if any
+		std::optional<TestContext*> TryTakeDeferred();
+
+		// As TryTakeDeferred, but waits for tests holding resources to finish.
+		// Returns nothing once there are no deferred tests left, or on cancellation.
+		std::optional<TestContext*> TakeDeferred(std::stop_token token);
+
+	private:
+		struct Usage
+		{
+			int Used = 0;
+			int Capacity = 1;
+			int Abandoned = 0; // of those using it, how many were abandoned while still running
+		};
+
+		bool TryAcquireLocked(const TestDefinition& test);
+		bool StrandLocked(TestContext& test);
+		std::optional<TestContext*> TakeDeferredLocked();
+		void Release(const std::vector<TestResource>& resources, bool abandoned);
+
+		std::mutex _mutex;
+		std::condition_variable_any _released;
+		std::unordered_map<std::string, Usage> _usage;
+		std::vector<TestContext*> _deferred;
+		std::function<void()> _onReleased;
+		std::function<void(TestContext&)> _onStranded;
+	};
+}
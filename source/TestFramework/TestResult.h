@@ -1,8 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <format>
+#include <utility>
+#include <vector>
+
+#include "TestDefinition.h"
+#include "TestStatus.h"
+#include "TestMeasurements.h"
 
 namespace lsn::test_framework
 {
@@ -40,38 +52,293 @@ private:
 	int _errorLine;
 };
 
-struct TestResult
+// What became of each instance of a parameterized test, gathered from every range they were run in. The counts
+// cover every instance while the failures and benchmarks are only kept for the lowest MaxRecorded indices, so a
+// source of millions can't hold on to millions of them. Written by the runner while the UI reads it, hence the lock.
+class TestInstanceResults
 {
-	std::chrono::nanoseconds _timeStarted = std::chrono::nanoseconds::zero();
-	std::chrono::nanoseconds _timeEnded = std::chrono::nanoseconds::zero();
-	std::optional<test_failure> _lastFailure;
+public:
+	static constexpr size_t MaxRecorded = 1024;
+
+	enum class Outcome { NotRun, Passed, Failed };
+
+	// Everything at once, e.g. to send back from a worker process
+	struct Snapshot
+	{
+		uint64_t NumPassed = 0;
+		uint64_t NumFailed = 0;
+		std::vector<InstanceRange> Ran;
+		std::vector<std::pair<uint64_t, test_failure>> Failures; // by index
+		std::vector<std::pair<uint64_t, BenchmarkStatistics>> Benchmarks; // by index
+	};
+
+	TestInstanceResults() = default;
+	explicit TestInstanceResults(const Snapshot& snapshot) { Merge(snapshot); }
+	TestInstanceResults(const TestInstanceResults& other) : TestInstanceResults(other.Read()) {}
+	TestInstanceResults& operator=(const TestInstanceResults&) = delete;
+
+	// Only the first outcome an instance is given counts, later ones are of the range it was in
+	void Record(uint64_t index, const test_failure* failure, const BenchmarkStatistics* benchmark = nullptr)
+	{
+		std::lock_guard lock(_mutex);
+		if (Contains(index))
+			return;
+
+		MarkRan({ index, index + 1 });
+		if (failure)
+		{
+			++_numFailed;
+			Keep(_failures, index, *failure);
+		}
+		else
+		{
+			++_numPassed;
+		}
+
+		if (benchmark)
+			Keep(_benchmarks, index, *benchmark);
+	}
+
+	// Of instances it hasn't seen, another range of the same test
+	void Merge(const Snapshot& other)
+	{
+		std::lock_guard lock(_mutex);
+		_numPassed += other.NumPassed;
+		_numFailed += other.NumFailed;
+		for (auto range : other.Ran)
+			MarkRan(range);
+		for (const auto& [index, failure] : other.Failures)
+			Keep(_failures, index, failure);
+		for (const auto& [index, benchmark] : other.Benchmarks)
+			Keep(_benchmarks, index, benchmark);
+	}
+
+	Snapshot Read() const
+	{
+		std::lock_guard lock(_mutex);
+		Snapshot snapshot{ _numPassed, _numFailed };
+		for (const auto& [begin, end] : _ran)
+			snapshot.Ran.push_back({ begin, end });
+		snapshot.Failures.assign(_failures.begin(), _failures.end());
+		snapshot.Benchmarks.assign(_benchmarks.begin(), _benchmarks.end());
+		return snapshot;
+	}
+
+	Outcome OutcomeOf(uint64_t index) const
+	{
+		std::lock_guard lock(_mutex);
+		if (!Contains(index))
+			return Outcome::NotRun;
+
+		// one that failed past the failures we keep is only known to have run
+		return _failures.contains(index) ? Outcome::Failed : Outcome::Passed;
+	}
+
+	std::optional<test_failure> FailureOf(uint64_t index) const
+	{
+		std::lock_guard lock(_mutex);
+		auto it = _failures.find(index);
+		return it != _failures.end() ? std::optional(it->second) : std::nullopt;
+	}
+
+	uint64_t NumPassed() const { std::lock_guard lock(_mutex); return _numPassed; }
+	uint64_t NumFailed() const { std::lock_guard lock(_mutex); return _numFailed; }
+
+private:
+	bool Contains(uint64_t index) const
+	{
+		auto it = _ran.upper_bound(index);
+		return it != _ran.begin() && index < std::prev(it)->second;
+	}
+
+	// joined up with its neighbours, so a test run in order is a single range
+	void MarkRan(InstanceRange range)
+	{
+		if (range.Size() == 0)
+			return;
+
+		auto it = _ran.emplace(range.Begin, range.End).first;
+		if (auto next = std::next(it); next != _ran.end() && next->first == it->second)
+		{
+			it->second = next->second;
+			_ran.erase(next);
+		}
+		if (it != _ran.begin())
+		{
+			if (auto previous = std::prev(it); previous->second == it->first)
+			{
+				previous->second = it->second;
+				_ran.erase(it);
+			}
+		}
+	}
+
+	template<typename T>
+	static void Keep(std::map<uint64_t, T>& kept, uint64_t index, const T& value)
+	{
+		kept.emplace(index, value);
+		if (kept.size() > MaxRecorded)
+			kept.erase(std::prev(kept.end()));
+	}
+
+	mutable std::mutex _mutex;
+	uint64_t _numPassed = 0;
+	uint64_t _numFailed = 0;
+	std::map<uint64_t, uint64_t> _ran; // the instances that have run, begin to end
+	std::map<uint64_t, test_failure> _failures;
+	std::map<uint64_t, BenchmarkStatistics> _benchmarks;
+};
+
+// The outcome of a single test. Written by whichever worker is running the test while the UI reads it every frame,
+// so the timings sit behind a sequence lock and the failure is swapped in whole. Reading the timings never blocks,
+// it only retries should it race a write. The shared pointers are a different matter, std::atomic<std::shared_ptr>
+// takes a lock inside both libstdc++ and msvc, so loading the failure or the measurements can briefly wait on a
+// writer. Padded out to a cache line so neighbouring results don't false share.
+struct alignas(64) TestResult
+{
+	TestResult() = default;
+
+	// Copies are consistent snapshots
+	TestResult(const TestResult& other)
+	{
+		*this = other;
+	}
+
+	TestResult& operator=(const TestResult& other)
+	{
+		auto values = other.Read(true);
+		Write([&]()
+		{
+			_timeStarted.store(values.TimeStarted, std::memory_order_relaxed);
+			_timeEnded.store(values.TimeEnded, std::memory_order_relaxed);
+			_cost.store(values.Gathered, std::memory_order_relaxed);
+			_failed.store(values.Failed, std::memory_order_relaxed);
+			_lastFailure.store(std::move(values.Failure));
+			_measurements.store(other._measurements.load());
+		});
+
+		// its own copy, as the other may still be recording into theirs
+		auto instances = other._instances.load();
+		_instances.store(instances ? std::make_shared<TestInstanceResults>(*instances) : nullptr);
+		return *this;
+	}
 
 	void Reset()
 	{
-		_lastFailure.reset();
-		_timeEnded = std::chrono::nanoseconds::zero();
-		_timeStarted = std::chrono::nanoseconds::zero();
+		Write([&]()
+		{
+			_timeStarted.store(0, std::memory_order_relaxed);
+			_timeEnded.store(0, std::memory_order_relaxed);
+			_cost.store(0, std::memory_order_relaxed);
+			_failed.store(false, std::memory_order_relaxed);
+			_lastFailure.store(nullptr);
+			_measurements.store(nullptr);
+		});
+		_instances.store(nullptr);
+	}
+
+	// Adds in another part of the same test, a range of its instances. Runs from when the first part started until
+	// the last one ended, which can be less than the cost of them all when they ran alongside each other. Keeps the
+	// first failure and measurements it's given, along with what became of every instance.
+	void Gather(const TestResult& part)
+	{
+		auto values = part.Read(true);
+		auto measurements = part._measurements.load();
+		// one failed before it got going has only ended
+		auto partStarted = values.TimeStarted > 0 ? values.TimeStarted : values.TimeEnded;
+
+		Write([&]()
+		{
+			if (values.TimeEnded > 0)
+			{
+				auto started = _timeStarted.load(std::memory_order_relaxed);
+				auto ended = _timeEnded.load(std::memory_order_relaxed);
+				_timeStarted.store(started > 0 ? std::min(started, partStarted) : partStarted, std::memory_order_relaxed);
+				_timeEnded.store(std::max(ended, values.TimeEnded), std::memory_order_relaxed);
+				_cost.store(_cost.load(std::memory_order_relaxed) + values.Cost(), std::memory_order_relaxed);
+			}
+
+			if (values.Failed && !_failed.load(std::memory_order_relaxed))
+			{
+				_failed.store(true, std::memory_order_relaxed);
+				_lastFailure.store(std::move(values.Failure));
+			}
+
+			if (measurements && !_measurements.load())
+				_measurements.store(std::move(measurements));
+		});
+
+		if (auto instances = part._instances.load())
+			EditInstances()->Merge(instances->Read());
+	}
+
+	// Of a parameterized test, only once one of its instances has run
+	std::shared_ptr<const TestInstanceResults> Instances() const {
+		return _instances.load();
+	}
+
+	void RecordInstance(uint64_t index, const test_failure* failure, const BenchmarkStatistics* benchmark = nullptr) {
+		EditInstances()->Record(index, failure, benchmark);
+	}
+
+	void SetInstances(const TestInstanceResults::Snapshot& instances) {
+		_instances.store(std::make_shared<TestInstanceResults>(instances));
 	}
 
 	void Begin(std::chrono::nanoseconds timeStarted) {
-		_timeStarted = timeStarted;
+		Write([&]() { _timeStarted.store(timeStarted.count(), std::memory_order_relaxed); });
 	}
 
 	void SetFailure(const test_failure& failure)
 	{
-		_lastFailure = failure;
+		auto shared = std::make_shared<const test_failure>(failure);
+		Write([&]()
+		{
+			_failed.store(true, std::memory_order_relaxed);
+			_lastFailure.store(std::move(shared));
+		});
+	}
+
+	// Swapped in whole like the failure
+	void SetMeasurements(const TestMeasurements& measurements)
+	{
+		_measurements.store(std::make_shared<const TestMeasurements>(measurements));
 	}
 
 	void End(std::chrono::nanoseconds timeEnded) {
-		_timeEnded = timeEnded;
+		Write([&]() { _timeEnded.store(timeEnded.count(), std::memory_order_relaxed); });
+	}
+
+	std::chrono::nanoseconds TimeStarted() const {
+		return std::chrono::nanoseconds(Read().TimeStarted);
+	}
+
+	std::chrono::nanoseconds TimeEnded() const {
+		return std::chrono::nanoseconds(Read().TimeEnded);
 	}
 
 	std::chrono::nanoseconds TimeTaken() const {
-		return _timeEnded - _timeStarted;
+		auto values = Read();
+		return std::chrono::nanoseconds(values.TimeEnded - values.TimeStarted);
+	}
+
+	// The time spent running it, which is the sum of its parts for a test that was gathered
+	std::chrono::nanoseconds Cost() const {
+		return std::chrono::nanoseconds(Read().Cost());
+	}
+
+	// Stays valid for as long as it's held, even if the test is rerun in the meantime
+	std::shared_ptr<const test_failure> LastFailure() const {
+		return _lastFailure.load();
+	}
+
+	// Nothing until the test has measured something
+	std::shared_ptr<const TestMeasurements> Measurements() const {
+		return _measurements.load();
 	}
 
 	bool HasStarted() const {
-		return _timeStarted.count() > 0;
+		return Read().TimeStarted > 0;
 	}
 
 	bool HasEnded() const {
@@ -79,14 +346,97 @@ struct TestResult
 	}
 
 	bool HasRun() const {
-		return _timeEnded.count() > 0;
+		return Read().TimeEnded > 0;
 	}
 
 	bool HasPassed() const {
-		return !_lastFailure.has_value();
+		return !Read().Failed;
+	}
+
+	// Passed, failed or not run, from a single read
+	TestResultStatus Status() const
+	{
+		auto values = Read();
+		if (values.TimeEnded <= 0)
+			return TestResultStatus::NotRun;
+
+		return values.Failed ? TestResultStatus::Failed : TestResultStatus::Passed;
 	}
 
 	operator bool() const { return HasPassed(); }
+
+private:
+	struct Values
+	{
+		int64_t TimeStarted = 0;
+		int64_t TimeEnded = 0;
+		int64_t Gathered = 0;
+		bool Failed = false;
+		std::shared_ptr<const test_failure> Failure;
+
+		// nothing was gathered into one that ran as a whole
+		int64_t Cost() const {
+			if (Gathered > 0)
+				return Gathered;
+			return TimeStarted > 0 ? std::max<int64_t>(TimeEnded - TimeStarted, 0) : 0;
+		}
+	};
+
+	// The sequence is odd while a write is in progress, writers take turns by moving it off an even number
+	template<typename Func>
+	void Write(Func&& write)
+	{
+		auto sequence = _sequence.load(std::memory_order_relaxed);
+		while ((sequence & 1) || !_sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			sequence = _sequence.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_release);
+		write();
+		_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	Values Read(bool withFailure = false) const
+	{
+		Values values;
+		while (true)
+		{
+			auto sequence = _sequence.load(std::memory_order_acquire);
+			if (sequence & 1)
+				continue;
+
+			values.TimeStarted = _timeStarted.load(std::memory_order_relaxed);
+			values.TimeEnded = _timeEnded.load(std::memory_order_relaxed);
+			values.Gathered = _cost.load(std::memory_order_relaxed);
+			values.Failed = _failed.load(std::memory_order_relaxed);
+			values.Failure = withFailure && values.Failed ? _lastFailure.load() : nullptr;
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (_sequence.load(std::memory_order_relaxed) == sequence)
+				return values;
+		}
+	}
+
+	std::atomic<uint32_t> _sequence{ 0 };
+	std::atomic<int64_t> _timeStarted{ 0 };
+	std::atomic<int64_t> _timeEnded{ 0 };
+	std::atomic<int64_t> _cost{ 0 }; // of the parts gathered into it
+	std::atomic<bool> _failed{ false };
+	std::atomic<std::shared_ptr<const test_failure>> _lastFailure;
+	std::atomic<std::shared_ptr<const TestMeasurements>> _measurements;
+	std::atomic<std::shared_ptr<TestInstanceResults>> _instances;
+
+	// only the one writer records into it at a time, but a reader may be copying it
+	std::shared_ptr<TestInstanceResults> EditInstances()
+	{
+		auto instances = _instances.load();
+		if (!instances)
+		{
+			auto created = std::make_shared<TestInstanceResults>();
+			if (_instances.compare_exchange_strong(instances, created))
+				instances = std::move(created);
+		}
+		return instances;
+	}
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "AtomicBitset.h"
+#include "TestDefinition.h"
+#include "TestObject.h"
+#include "TestResult.h"
+
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace lsn::test_framework
+{
+	// Which tests of the current session are scheduled, running and finished, a bit each per TestDefinition::Index.
+	// Any thread can query it every frame at the cost of a bit test. Tests without an index aren't tracked.
+	// Each change is also published to the test's object so the status counts of its categories follow along.
+	// A test run as several ranges of its instances is running from when the first starts until the last finishes.
+	class TestRunState
+	{
+	public:
+		// Clears the previous session, only call while no session is running
+		void Begin(size_t numTests)
+		{
+			for (auto* bits : { &_scheduled, &_running, &_finished })
+			{
+				bits->Reserve(numTests);
+				bits->ResetAll();
+			}
+
+			_gathered.clear();
+		}
+
+		// The test is run as numRanges ranges of its instances, each finishing into a result of its own that's
+		// gathered into the test's. Only call before any of them start.
+		void Gather(const TestDefinition& test, TestResult& result, size_t numRanges)
+		{
+			auto& gathered = _gathered[&test];
+			gathered.Result = &result;
+			gathered.Remaining = numRanges;
+		}
+
+		void End()
+		{
+			_scheduled.ResetAll();
+			_running.ResetAll();
+		}
+
+		void Schedule(const TestDefinition& test)
+		{
+			Update(_scheduled, test, true);
+			Publish(test, TestResultStatus::WaitingToRun);
+		}
+
+		void Start(const TestDefinition& test)
+		{
+			if (auto it = _gathered.find(&test); it != _gathered.end())
+			{
+				std::lock_guard lock(it->second.Mutex);
+				it->second.Begin();
+			}
+
+			Update(_finished, test, false);
+			Update(_running, test, true);
+			Publish(test, TestResultStatus::Running);
+		}
+
+		// Of a range, the test only finishes with the last of them. Its failure is that of the earliest range to fail.
+		void Finish(const TestDefinition& test, const TestResult& result, InstanceRange instances = {})
+		{
+			if (auto it = _gathered.find(&test); it != _gathered.end())
+			{
+				auto& gathered = it->second;
+				std::lock_guard lock(gathered.Mutex);
+				gathered.Begin();
+				gathered.Result->Gather(result);
+
+				auto failure = result.LastFailure();
+				if (failure && instances.Begin < gathered.FailedAt)
+				{
+					gathered.FailedAt = instances.Begin;
+					gathered.Result->SetFailure(*failure);
+				}
+
+				if (--gathered.Remaining > 0)
+					return;
+
+				Update(_finished, test, true);
+				Update(_running, test, false);
+				Settle(test, *gathered.Result);
+				return;
+			}
+
+			Update(_finished, test, true);
+			Update(_running, test, false);
+			Settle(test, result);
+		}
+
+		// Publishes the status of a test's result, for tests that were scheduled but never got to run
+		static void Settle(const TestDefinition& test, const TestResult& result)
+		{
+			Publish(test, result.Status());
+		}
+
+		// Marks a test as running until the returned scope is destroyed
+		struct RunningScope
+		{
+			RunningScope(TestRunState& state, const TestDefinition& test, const TestResult& result, InstanceRange instances = {}) : _state(state), _test(test), _result(result), _instances(instances) { _state.Start(_test); }
+			RunningScope(const RunningScope&) = delete;
+			~RunningScope() { _state.Finish(_test, _result, _instances); }
+
+		private:
+			TestRunState& _state;
+			const TestDefinition& _test;
+			const TestResult& _result;
+			InstanceRange _instances;
+		};
+
+		bool IsScheduled(const TestDefinition& test) const { return _scheduled.Test(test.Index); }
+		bool IsRunning(const TestDefinition& test) const { return _running.Test(test.Index); }
+		bool IsFinished(const TestDefinition& test) const { return _finished.Test(test.Index); }
+
+	private:
+		static void Publish(const TestDefinition& test, TestResultStatus status)
+		{
+			if (test._parent)
+				test._parent->SetStatus(status);
+		}
+
+		static void Update(AtomicBitset& bits, const TestDefinition& test, bool value)
+		{
+			if (test.Index >= bits.Size())
+				return;
+
+			if (value)
+				bits.Set(test.Index);
+			else
+				bits.Reset(test.Index);
+		}
+
+		struct Gathered
+		{
+			std::mutex Mutex;
+			TestResult* Result = nullptr;
+			size_t Remaining = 0;
+			uint64_t FailedAt = std::numeric_limits<uint64_t>::max();
+			bool Begun = false;
+
+			// the result from before is only cleared once the first range gets going
+			void Begin()
+			{
+				if (!std::exchange(Begun, true))
+					Result->Reset();
+			}
+		};
+
+		AtomicBitset _scheduled;
+		AtomicBitset _running;
+		AtomicBitset _finished;
+		// only added to before the session's tests start, so it's read without a lock
+		std::unordered_map<const TestDefinition*, Gathered> _gathered;
+	};
+}
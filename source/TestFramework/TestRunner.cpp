@@ -3,6 +3,16 @@
 #include "TestResult.h"
 #include "TestObject.h"
 #include "TestDefinition.h"
+#include "TestExecutor.h"
+#include "TestWatchdog.h"
+#include "WorkStealingQueue.h"
+#include "TestProcessPool.h"
+#include "TestResourceLocks.h"
+#include "TestDistributor.h"
+#include "TestCancellation.h"
+#include "TestCounters.h"
+#include "TestAllocations.h"
+#include "TestUsage.h"
 
 #include <thread>
 #include <vector>
@@ -12,28 +22,9 @@
 #include <chrono>
 #include <memory>
 #include <future>
-
-#if defined _WIN32
-#define NOMINMAX
-#include <Windows.h>
-#include <processthreadsapi.h>
-
-namespace lsn::thread_utils
-{
-	bool KillThread(std::thread& thread)
-	{
-		if (!thread.joinable())
-			return false;
-
-		if (!TerminateThread(thread.native_handle(), 0))
-			return false;
-		
-		thread.detach();
-		return true;
-	}
-}
-
-#endif
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
 
 namespace lsn::test_framework
 {
@@ -41,11 +32,19 @@ namespace lsn::test_framework
 //===========================================================================================================
 void TestContext::SetFailure(const std::string& reason)
 {
-	SetFailure(test_failure(reason, Definition->_parent->File, Definition->_parent->LineNumber));
+	auto described = Describe();
+	if (!described.empty())
+		described = std::format("{}: {}", described, reason);
+
+	SetFailure(test_failure(described.empty() ? reason : described, Definition->_parent->File, Definition->_parent->LineNumber));
 }
 
 void TestContext::SetFailure(const test_failure& reason)
 {
+	// the one instance being run failed along with it, unless it had already finished
+	if (Definition->NumInstances > 0 && Instances.Size() == 1)
+		Result->RecordInstance(Instances.Begin, &reason);
+
 	Result->SetFailure(reason);
 	Result->End(std::chrono::high_resolution_clock::now().time_since_epoch());
 }
@@ -61,18 +60,39 @@ std::chrono::milliseconds TestContext::DetermineTimeout(const TestExecutionOptio
 	if (options.MaximumTimeout.has_value())
 		timeout = std::min(timeout, options.MaximumTimeout.value());
 
-	return timeout;
+	return timeout * TimeoutScale;
+}
+
+std::string TestContext::Describe() const
+{
+	if (Definition->NumInstances == 0 || Instances.Size() == 0)
+		return {};
+
+	if (Instances.Size() == 1)
+		return Definition->_describe(Instances.Begin);
+
+	return std::format("{}[{}..{}]", Definition->_parent->Name, Instances.Begin, Instances.End - 1);
 }
 //===========================================================================================================
 
+// A session still in flight is cancelled and waited on. Any test that won't stop is abandoned within the grace
+// period, or killed along with its worker process under process isolation, so the session always returns.
 TestRunner::~TestRunner()
 {
-	if (_thread.joinable())
-		lsn::thread_utils::KillThread(_thread);
+	_stopSource.request_stop();
+	Join();
 }
 
 bool TestRunner::IsScheduled(const TestDefinition* test) const {
-	return _tests.contains(test);
+	return _state.IsScheduled(*test);
+}
+
+bool TestRunner::IsRunning(const TestDefinition* test) const {
+	return _state.IsRunning(*test);
+}
+
+bool TestRunner::IsFinished(const TestDefinition* test) const {
+	return _state.IsFinished(*test);
 }
 
 
@@ -85,18 +105,58 @@ void TestRunner::Run(std::vector<TestContext>& tests, const TestExecutionOptions
 			return;
 	}
 
+	// a missing file just means there's no history yet
+	if (!_historyLoaded && !HistoryFile.empty())
+	{
+		_history.Load(HistoryFile);
+		_historyLoaded = true;
+	}
+
+	if (!_baselinesLoaded && !BaselineFile.empty())
+	{
+		_baselines.Load(BaselineFile);
+		_baselinesLoaded = true;
+	}
+
+	// a test with instances runs all of them unless it's narrowed down to some
+	for (auto& context : tests)
+	{
+		if (context.Definition->NumInstances > 0 && context.Instances.Size() == 0)
+			context.Instances = { 0, context.Definition->NumInstances };
+	}
+
+	_history.Estimate(tests);
+	if (options.Shard.IsSharded())
+	{
+		// balanced by the history as it was saved when there's no durations file to share
+		auto shard = options.Shard;
+		if (shard.DurationsFile.empty())
+			shard.DurationsFile = HistoryFile;
+		tests = shard.Select(tests);
+	}
+
 	// Determine if we need to cancel first.
 	Status = Status::Running;
-	_tests.clear();
+
+	// the bitsets only need to reach the highest index being run
+	uint32_t numIndexed = 0;
+	for (const auto& context : tests)
+	{
+		if (context.Definition->Index != TestDefinition::Unindexed)
+			numIndexed = std::max(numIndexed, context.Definition->Index + 1);
+	}
+
+	_state.Begin(numIndexed);
 	for (const auto& context : tests)
-		_tests.insert(context.Definition);
+		_state.Schedule(*context.Definition);
 	
 	_stopSource = {};
 
 	// if there are no threads, then execute everything on the main thread
 	if (options.MaxNumberOfSimultaneousThreads == 0)
 	{
-		TestRunner::RunAll(tests, options, this->_stopSource.get_token());
+		RunAll(tests, options, this->_stopSource.get_token());
+		OnFinish(tests);
 		return;
 	}
 
@@ -105,8 +165,8 @@ void TestRunner::Run(std::vector<TestContext>& tests, const TestExecutionOptions
 	
 	_thread = std::thread([=, this]() mutable
 	{
-		TestRunner::RunAll(tests, options, this->_stopSource.get_token());
-		this->OnFinish();
+		this->RunAll(tests, options, this->_stopSource.get_token());
+		this->OnFinish(tests);
 	});
 }
 
@@ -130,14 +190,28 @@ void TestRunner::Join()
 		_thread.join();
 }
 
-void TestRunner::OnFinish()
+void TestRunner::OnFinish(std::span<const TestContext> tests)
 {
+	// anything cancelled before it started goes back to the status of its last result
+	for (const auto& context : tests)
+		TestRunState::Settle(*context.Definition, *context.Result);
+
+	_state.End();
 	Status = Status::Idle;
-	_tests.clear();
 }
 	
 void TestRunner::RunAll(std::vector<TestContext>& tests, const TestExecutionOptions& options, std::stop_token token)
 {
+	if (options.Isolation == TestIsolation::Process)
+		_processPool.Reserve(std::max(options.MaxNumberOfSimultaneousThreads, 1));
+	else if (options.Isolation == TestIsolation::Distributed)
+		_processPool.Reserve(1);
+	else if (options.Isolation == TestIsolation::Zygote)
+		_processPool.StartZygote();
+
+	_ranges.clear();
+	_rangeResults.clear();
+
 	// Split the tests into different cohorts
 	std::array<std::vector<TestContext*>, static_cast<int>(TestConcurrency::Count)> _cohorts;
 	for (auto& context : tests)
@@ -146,20 +220,67 @@ void TestRunner::RunAll(std::vector<TestContext>& tests, const TestExecutionOpti
 
 		concurrency = std::min(concurrency, options.MaximumConcurrency.value_or(concurrency));
 		concurrency = options.EnforcedConcurrency.value_or(concurrency);
-		_cohorts[static_cast<int>(concurrency)].push_back(&context);
+		Split(context, options, _cohorts[static_cast<int>(concurrency)]);
 	}
 
+	// Longest first, so a long test registered last doesn't become the tail of the run.
+	// Ties keep their registration order.
+	for (auto& cohort : _cohorts)
+	{
+		std::stable_sort(cohort.begin(), cohort.end(), [](const TestContext* lhs, const TestContext* rhs)
+		{
+			return lhs->EstimatedDuration > rhs->EstimatedDuration;
+		});
+	}
+
+	// Tests that use the same named resources are kept apart, while everything else is packed onto the pool.
+	// Shared, as a test abandoned while still running holds on to its resources until it returns.
+	auto locks = std::make_shared<TestResourceLocks>();
+	auto& resources = *locks;
+	// a range that's stranded still has to be gathered into its test
+	resources.OnStranded([this](TestContext& test) { _state.Finish(*test.Definition, *test.Result, test.Instances); });
+
 	// anything that is exclusive we run now.
-	TestRunner::RunAsync(std::span(_cohorts[static_cast<int>(TestConcurrency::Exclusive)]), options, token);
+	RunAsync(std::span(_cohorts[static_cast<int>(TestConcurrency::Exclusive)]), resources, options, token);
 
 	if (token.stop_requested())
 		return;
 
-	// Create worker threads for our remainder, and allow them to take from the Any pool
-	// we will maintain as our own worker thread and process the Privileged, before assisting with the remaining pool
 	const auto& remainder = _cohorts[static_cast<int>(TestConcurrency::Any)];
 	const auto& privelaged = _cohorts[static_cast<int>(TestConcurrency::Privileged)];
 
+	if (options.Isolation == TestIsolation::Distributed && TestDistributor::IsSupported())
+	{
+		// Worker processes lease the any cohort between them while the privileged tests run alongside as usual
+		auto privileged = _executor.Execute([&]() { RunAsync(std::span(privelaged), resources, options, token); });
+		_distributor.Run(std::span(remainder), _state, resources, options, token);
+		privileged->Wait();
+	}
+	else
+	{
+		RunShared(remainder, privelaged, resources, options, token);
+	}
+
+	// a cancelled session would only skew the history
+	if (token.stop_requested())
+		return;
+
+	// failed here, before the session finishes, so the regressions are settled like any other failure
+	_baselines.Gate(tests, options);
+	if (!BaselineFile.empty())
+		_baselines.Save(BaselineFile);
+
+	_history.Record(tests);
+	if (!HistoryFile.empty())
+		_history.Save(HistoryFile);
+
+	// and we're done!
+}
+
+// Create worker threads for our remainder, and allow them to take from the Any pool
+// we will maintain as our own worker thread and process the Privileged, before assisting with the remaining pool
+void TestRunner::RunShared(std::span<TestContext* const> remainder, std::span<TestContext* const> privelaged, TestResourceLocks& resources, const TestExecutionOptions& options, std::stop_token token)
+{
 	int numAdditionalThreads = 0;
 	// determine how many additional threads will be needed 
 	if (remainder.size() > 0)
@@ -172,118 +293,373 @@ void TestRunner::RunAll(std::vector<TestContext>& tests, const TestExecutionOpti
 		numAdditionalThreads = std::min(preferredNumThreads, availableThreads);
 	}
 
-	std::atomic<size_t> work_index{ 0 };
-	auto pool_worker = [&]()
+	// Every pool worker gets its own share of the Any cohort. Our own queue (index 0) starts empty as we have
+	// the privileged tests to get through first, the moment those run dry we start stealing from the others.
+	numAdditionalThreads = std::max(numAdditionalThreads, 0);
+	std::vector<WorkStealingQueue<TestContext*>> queues(numAdditionalThreads + 1);
+	for (size_t i = 0; i < remainder.size(); ++i)
+	{
+		size_t owner = numAdditionalThreads > 0 ? 1 + (i % numAdditionalThreads) : 0;
+		queues[owner].Push(remainder[i]);
+	}
+
+	// the results of what each worker runs tell whether there are more workers than cores for them
+	OversubscriptionMonitor monitor(numAdditionalThreads + 1, options.OversubscriptionThreshold, options.ParkOversubscribedWorkers);
+	auto record = [&monitor](std::span<TestContext* const> tests)
+	{
+		for (auto* test : tests)
+		{
+			if (auto measured = test->Result->Measurements(); measured && measured->Usage)
+				monitor.Record(*measured->Usage);
+		}
+	};
+
+	auto pool_worker = [&](size_t self)
 	{
 		while (!token.stop_requested())
 		{
-			size_t index = work_index++;
-			if (index >= remainder.size())
+			// a parked worker's queue is left to be stolen by the rest, we're never parked ourselves
+			if (self != 0 && self >= (size_t)monitor.ActiveWorkers())
 				break;
 
-			TestRunner::Run(*remainder[index], options, token);
+			// tests that were waiting on a resource go first, they've already been held back once
+			auto next = resources.TryTakeDeferred();
+			if (!next)
+			{
+				next = queues[self].Pop();
+				for (size_t i = 1; !next && i < queues.size(); ++i)
+					next = queues[(self + i) % queues.size()].Steal();
+
+				// one of its resources is held, move on to something that doesn't conflict
+				if (next && !resources.TryAcquire(*(*next)->Definition))
+				{
+					resources.Defer(*next);
+					continue;
+				}
+			}
+
+			// nothing is ever added to the queues once we've started, so once they are empty
+			// all that's left is to wait out any deferred tests
+			if (!next)
+				next = resources.TakeDeferred(token);
+
+			if (!next)
+				break;
+
+			if (auto running = Run(**next, options, token))
+				resources.ReleaseOnExit(*(*next)->Definition, running);
+			else
+				resources.Release(*(*next)->Definition);
+			record(std::span(&*next, 1));
 		}
 	};
 
-	// Generate threads as needed
-	std::vector<std::thread> threads;
-	while (numAdditionalThreads-- > 0)
-		threads.emplace_back(pool_worker);
+	// Borrow workers from the executor as needed
+	std::vector<TestExecutor::JobHandle> workers;
+	for (int i = 1; i <= numAdditionalThreads; ++i)
+		workers.push_back(_executor.Execute([&pool_worker, i]() { pool_worker(i); }));
 
 	// Run the privelaged on our thread
-	TestRunner::RunAsync(std::span(privelaged), options, token);
+	RunAsync(std::span(privelaged), resources, options, token);
 
 	// Help with the remainder of the any tests
-	std::invoke(pool_worker);
+	pool_worker(0);
 
-	// Join the rest of the threads
-	for (auto& thread : threads)
-		thread.join();
+	// Wait for the rest of the workers
+	for (const auto& worker : workers)
+		worker->Wait();
 
-	// and we're done!
+	_numParkedWorkers += numAdditionalThreads + 1 - monitor.ActiveWorkers();
+	_numOversubscriptions += monitor.NumOversubscribed();
 }
 
-void TestRunner::RunAsync(std::span<TestContext* const> tests, const TestExecutionOptions& options, std::stop_token token)
+void TestRunner::Split(TestContext& test, const TestExecutionOptions& options, std::vector<TestContext*>& ranges)
+{
+	auto instances = test.Instances;
+	if (test.Definition->NumInstances == 0 || instances.Size() <= 1)
+	{
+		ranges.push_back(&test);
+		return;
+	}
+
+	// only instances we know to be cheap, and which can run alongside anything, share a range
+	auto estimate = test.EstimatedDuration / test.Definition->NumInstances;
+	bool cheap = options.Isolation == TestIsolation::Thread && test.Definition->Resources.empty()
+		&& estimate.count() > 0 && estimate < options.BatchDuration;
+
+	uint64_t size = cheap ? std::clamp<uint64_t>(options.BatchDuration / estimate, 1, MaxBatchSize) : 1;
+	uint64_t forced = (instances.Size() + MaxRanges - 1) / MaxRanges;
+	uint64_t scale = forced > size ? (forced + size - 1) / size : 1;
+	size = std::max(size, forced);
+
+	auto numRanges = (instances.Size() + size - 1) / size;
+	if (numRanges == 1)
+	{
+		ranges.push_back(&test);
+		return;
+	}
+
+	_state.Gather(*test.Definition, *test.Result, numRanges);
+	for (auto begin = instances.Begin; begin < instances.End; begin += size)
+	{
+		auto& result = _rangeResults.emplace_back();
+		auto& range = _ranges.emplace_back(test);
+		range.Result = &result;
+		range.EstimatedDuration = estimate * size;
+		range.Instances = { begin, std::min(begin + size, instances.End) };
+		range.TimeoutScale = scale;
+		ranges.push_back(&range);
+	}
+}
+
+void TestRunner::RunAsync(std::span<TestContext* const> tests, TestResourceLocks& resources, const TestExecutionOptions& options, std::stop_token token)
 {
 	for (auto* test : tests)
 	{
+		// not acquiring them and not being cancelled means the test was failed for want of them
+		bool acquired = resources.Acquire(*test, token);
 		if (token.stop_requested())
+		{
+			if (acquired)
+				resources.Release(*test->Definition);
 			return;
+		}
 
-		TestRunner::Run(*test, options, token);
+		if (!acquired)
+			continue;
+
+		if (auto running = Run(*test, options, token))
+			resources.ReleaseOnExit(*test->Definition, running);
+		else
+			resources.Release(*test->Definition);
 	}
 }
 
 // Intentional copy of the context
-void TestRunner::Run(TestContext context, const TestExecutionOptions& options, std::stop_token token)
+TestExecutor::JobHandle TestRunner::Run(TestContext context, const TestExecutionOptions& options, std::stop_token token)
 {
 	using namespace std::chrono_literals;
 
 	auto timeout = context.DetermineTimeout(options);
+	TestRunState::RunningScope running(_state, *context.Definition, *context.Result, context.Instances);
+	if (context.Instances.Size() > 1)
+		++_numBatches;
 
-	// TODO: This has a crash issue as the context can be destroyed while the thread is being killed at the assignment stage.
-	// Need a static synchronization system that will allow these to communicate better. (id's in a set maybe?)
-	// potentially a second stop token?
-	
-	std::atomic<bool> complete{ false };
-	std::thread thr([c=context, o=options, &complete]() mutable {
-		
-		TestRunner::RunInternal(c, o);
-		complete = true;
-		
-	});
+	// exclusive and privileged tests of a distributed run use the process pool
+	if (options.Isolation != TestIsolation::Thread && TestProcessPool::IsSupported())
+	{
+		if (options.Isolation == TestIsolation::Zygote)
+			_processPool.RunForked(context, timeout, token);
+		else
+			_processPool.Run(context, timeout, token);
+		return nullptr;
+	}
 
-	auto startTime = std::chrono::high_resolution_clock::now().time_since_epoch();
-	while (!complete)
+	// A range is run in one job under one deadline. Should an instance hang or be cancelled it's failed on its
+	// own, the rest of the range picking up after it in a job of their own, each part gathered into the result.
+	context.Result->Reset();
+	for (auto begin = context.Instances.Begin; ; )
 	{
-		auto delta = std::chrono::high_resolution_clock::now().time_since_epoch() - startTime;
-		if (delta >= timeout)
+		// The context and options are copied into the job, as a job that is abandoned can outlive this call. It
+		// runs against a scratch result, gathered once it's done, as an abandoned job that couldn't be killed
+		// carries on writing to it. progress is the instance the job is on.
+		auto scratch = std::make_shared<TestResult>();
+		auto progress = std::make_shared<std::atomic<uint64_t>>(begin);
+		auto part = context;
+		part.Result = scratch.get();
+		part.Instances.Begin = begin;
+
+		std::stop_source stop;
+		auto job = _executor.Execute([c=part, o=options, t=stop.get_token(), scratch, progress]() mutable {
+			TestRunner::RunInternal(c, o, t, progress.get());
+		});
+
+		// Sleep until the test finishes, the watchdog expires it, or we're cancelled
+		auto ticket = _watchdog.Watch(job, timeout);
+		std::stop_callback onCancel(token, [job]() { job->Notify(TestExecutor::Job::Cancelled); });
+
+		auto events = job->WaitForAny();
+		_watchdog.Unwatch(ticket);
+
+		if (events & TestExecutor::Job::Finished)
 		{
-			if (lsn::thread_utils::KillThread(thr))
-			{
-				context.SetFailure(std::format("exceeded timeout duration of {}", timeout));
-				break;
-			}
+			context.Result->Gather(*scratch);
+			return nullptr;
 		}
-		
-		if (token.stop_requested())
+
+		// Ask the test to stop, one that checks for cancellation will unwind within moments
+		stop.request_stop();
+		auto grace = _watchdog.Watch(job, CancellationGracePeriod, TestExecutor::Job::Overdue);
+		events = job->WaitFor(TestExecutor::Job::Finished | TestExecutor::Job::Overdue);
+		_watchdog.Unwatch(grace);
+
+		// a worker that couldn't be stopped is retired and left to finish on its own
+		bool stillRunning = !(events & TestExecutor::Job::Finished) && !_executor.Abandon(job);
+
+		// the instance it had reached takes the blame, the failure of any before it comes first regardless
+		TestResult reached = *scratch;
+		part.Result = &reached;
+		if (auto at = progress->load(); part.Instances.Size() > 0)
+			part.Instances = { at, at + 1 };
+
+		auto reason = events & TestExecutor::Job::Expired ? std::format("exceeded timeout duration of {}", timeout / context.TimeoutScale) : "cancelled";
+		if (part.Instances.Size() > 0 && !reached.HasPassed())
 		{
-			// TODO: This causing problems currently.
-			// lsn::thread_utils::KillThread(thr);
-			context.SetFailure(std::format("cancelled"));
-			break;
+			// only the instance is failed, the test keeps the failure from before it
+			test_failure failure(reason, context.Definition->_parent->File, context.Definition->_parent->LineNumber);
+			reached.RecordInstance(part.Instances.Begin, &failure);
+			reached.End(std::chrono::high_resolution_clock::now().time_since_epoch());
+		}
+		else
+		{
+			part.SetFailure(reason);
 		}
-	}
 
-	if (thr.joinable())
-		thr.join();
+		context.Result->Gather(reached);
+
+		begin = part.Instances.End;
+		if (stillRunning || token.stop_requested() || begin >= context.Instances.End)
+			return stillRunning ? job : nullptr;
+	}
 };
 
-void TestRunner::RunInternal(TestContext& context, const TestExecutionOptions& options)
+namespace
 {
-	context.Result->Reset();
-
-	try
+	// The test's failure, if it failed
+	template<typename Test>
+	std::optional<test_failure> Attempt(const TestContext& context, Test&& test)
 	{
-		context.Result->Begin(std::chrono::high_resolution_clock::now().time_since_epoch());
-		std::invoke(context.Definition->_test);
-		context.Result->End(std::chrono::high_resolution_clock::now().time_since_epoch());
+		auto named = [&](const std::string& reason) { return test_failure(reason, context.Definition->_parent->File, context.Definition->_parent->LineNumber); };
+
+		try
+		{
+			std::invoke(test);
+			return std::nullopt;
+		}
+		catch (test_failure failure)
+		{
+			return failure;
+		}
+		catch (test_cancelled)
+		{
+			return named("cancelled");
+		}
+		catch (std::exception unexpected_failure)
+		{
+			return named(unexpected_failure.what());
+		}
+		catch (...) // unknown failure
+		{
+			return named("uknown exception encountered");
+		}
 	}
-	catch (test_failure failure)
+}
+
+namespace
+{
+	// whether each initializer has run in this process, which anything forked from it inherits
+	std::mutex s_initializedMutex;
+	std::unordered_map<const TestObject*, std::once_flag> s_initialized;
+}
+
+void TestRunner::Initialize(const TestObject& test)
+{
+	std::vector<const TestObject*> initializers;
+	for (const auto* node = &test; node; node = node->Parent)
 	{
-		context.SetFailure(failure);
-		// TODO:
+		if (node->Initialize)
+			initializers.push_back(node);
 	}
-	catch (std::exception unexpected_failure)
+
+	// one that throws is tried again by the next test that needs it
+	for (auto it = initializers.rbegin(); it != initializers.rend(); ++it)
 	{
-		context.SetFailure(unexpected_failure.what());
+		std::once_flag* once = nullptr;
+		{
+			std::lock_guard lock(s_initializedMutex);
+			once = &s_initialized[*it];
+		}
+		std::call_once(*once, (*it)->Initialize);
 	}
-	catch (...) // unknown failure
+}
+
+void TestRunner::RunInternal(TestContext& context, const TestExecutionOptions& options, std::stop_token token, std::atomic<uint64_t>* progress)
+{
+	const auto& definition = *context.Definition;
+	auto instances = context.Instances;
+
+	context.Result->Reset();
+	TestScope scope(context, token);
+	auto counters = TestCounters::Start();
+	auto usage = TestUsage::Start();
+	AllocationCounter allocations;
+
+	// each instance of a range is timed on its own, against the timeout it would have had on its own
+	auto timeout = context.DetermineTimeout(options);
+	auto instanceTimeout = timeout / context.TimeoutScale;
+
+	// not part of the test, so it's neither timed nor counted, but a test can't run without it
+	auto failure = Attempt(context, [&]() { Initialize(*definition._parent); });
+	if (failure)
+		instances = {};
+
+	context.Result->Begin(std::chrono::high_resolution_clock::now().time_since_epoch());
 	{
-		context.SetFailure("uknown exception encountered");
+		TestAllocations::Scope counting(allocations);
+		if (definition.NumInstances == 0 && !failure)
+			failure = Attempt(context, definition._test);
+
+		// The rest of the range still runs should one fail. Each instance's outcome is recorded, while the test's
+		// failure is the first of them.
+		for (auto i = instances.Begin; i < instances.End && !token.stop_requested(); ++i)
+		{
+			if (progress)
+				progress->store(i);
+
+			auto measured = context.Result->Measurements();
+			auto started = std::chrono::high_resolution_clock::now();
+			auto failed = Attempt(context, [&]() { definition._instance(i); });
+			// the one that was stopped is failed by whoever stopped it
+			if (token.stop_requested())
+				break;
+
+			auto taken = std::chrono::high_resolution_clock::now() - started;
+			if (!failed && taken > instanceTimeout)
+				failed = test_failure(std::format("exceeded timeout duration of {}", instanceTimeout), definition._parent->File, definition._parent->LineNumber);
+
+			// a benchmark swaps in measurements of its own
+			auto after = context.Result->Measurements();
+			const auto* benchmark = after != measured && after->Benchmark ? &*after->Benchmark : nullptr;
+
+			context.Result->RecordInstance(i, failed ? &*failed : nullptr, benchmark);
+
+			if (failed && !failure)
+				failure = test_failure(std::format("{}: {}", definition._describe(i), failed->error()), failed->filename(), failed->linenumber());
+		}
 	}
 
-	if (auto timeout = context.DetermineTimeout(options); context.Result->TimeTaken() > timeout)
+	if (failure)
+		context.SetFailure(*failure);
+	else
+		context.Result->End(std::chrono::high_resolution_clock::now().time_since_epoch());
+
+	// a benchmark has already put its statistics in
+	TestMeasurements measurements;
+	if (auto measured = context.Result->Measurements())
+		measurements = *measured;
+
+	measurements.Counters = TestCounters::Stop(counters);
+	measurements.Usage = TestUsage::Stop(usage);
+	if (TestAllocations::IsHooked())
+		measurements.Allocations = allocations.Statistics();
+	context.Result->SetMeasurements(measurements);
+
+	// a failure is already the more useful error, it likely allocated to throw as well
+	if (auto budget = context.Definition->MaxAllocations; budget && measurements.Allocations && allocations.Allocations > *budget && context.Result->HasPassed())
+		context.SetFailure(std::format("made {} allocations, over its budget of {}", allocations.Allocations, *budget));
+
+	// the instances of a range have already been held to theirs
+	if (definition.NumInstances == 0 && context.Result->TimeTaken() > timeout)
 	{
 		context.SetFailure(std::format("exceeded timeout duration of {}", timeout));
 	}
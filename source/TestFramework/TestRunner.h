@@ -2,18 +2,35 @@
 
 #include <optional>
 #include <vector>
+#include <deque>
 #include <array>
 #include <span>
-#include <unordered_set>
 #include <thread>
 
 #include "TestDefinition.h"
+#include "TestExecutor.h"
+#include "TestWatchdog.h"
+#include "TestProcessPool.h"
+#include "TestDistributor.h"
+#include "TestHistory.h"
+#include "TestBaselines.h"
+#include "TestShard.h"
+#include "TestRunState.h"
 
 namespace lsn::test_framework
 {
 	struct TestResult;
+	class TestResourceLocks;
 	class test_failure;
 
+	enum class TestIsolation
+	{
+		Thread, // tests run on a worker thread inside this process
+		Process, // tests are sent to a pool of forked worker processes, where supported
+		Zygote, // every test is forked from a pristine, pre-initialized process, where supported
+		Distributed, // worker processes lease batches of tests from this one as they need them, where supported
+	};
+
 	struct TestExecutionOptions
 	{
 		TestExecutionOptions& ForceOntoMainThread() { MaxNumberOfSimultaneousThreads = 0; return *this; }
@@ -21,6 +38,24 @@ namespace lsn::test_framework
 		int MaxNumberOfSimultaneousThreads = 6;
 		int MinimumNumberOfTestsPerThread = 2;
 		std::chrono::milliseconds DefaultTimeOut{ 5000 };
+		TestIsolation Isolation = TestIsolation::Thread;
+		TestShard Shard; // only this slice of the tests is run
+		// Cheap instances of a parameterized test are run back to back in ranges that should take about this long,
+		// going by their history. Zero runs every instance on its own.
+		std::chrono::microseconds BatchDuration{ 1000 };
+		// A benchmark fails when its median is this much slower than its baseline, and a Mann-Whitney U test
+		// puts it as slower at this significance
+		double RegressionThreshold = 0.10;
+		double RegressionSignificance = 0.01;
+		// Takes this session's samples as the new baselines rather than gating on the old ones, for once a
+		// benchmark is meant to have got slower
+		bool AcceptBaselines = false;
+		// Tests that never block yet get less than this share of the cpu over their wall time were waiting on a
+		// core, there are more workers than cores for them. Zero stops looking.
+		double OversubscriptionThreshold = 0.75;
+		// Parks a worker whenever they're found oversubscribed. Off by default, tests that pace themselves by the
+		// clock rather than by their work only take longer on fewer workers.
+		bool ParkOversubscribedWorkers = false;
 
 
 		// allows us to enforce the concurrency type if there are problems
@@ -35,11 +70,20 @@ namespace lsn::test_framework
 		// TODO: Should this be the object?
 		const TestDefinition* Definition;
 		TestResult* Result;
-
+		// from previous sessions, used to start the longest tests first
+		std::chrono::nanoseconds EstimatedDuration{ 0 };
+		// Of a test with instances, the ones run here. Its result is only theirs, the runner gathers them up.
+		InstanceRange Instances;
+		// a range holding more instances than it would have been given has as many times the timeout
+		uint64_t TimeoutScale = 1;
+
+		// prefixed with what's being run, when it's only some of a test's instances
 		void SetFailure(const std::string& reason);
 		void SetFailure(const test_failure& failure);
 
 		std::chrono::milliseconds DetermineTimeout(const TestExecutionOptions& options) const;
+		// The name of the one instance being run or the range of them, empty for a test without any
+		std::string Describe() const;
 	};
 
 	struct TestRunner
@@ -56,22 +100,71 @@ namespace lsn::test_framework
 
 		std::atomic<Status> Status{ Status::Idle };
 
+		// How long a cancelled or expired test has to notice and stop before its worker is abandoned
+		static constexpr std::chrono::milliseconds CancellationGracePeriod{ 100 };
+		// The most instances run in one range, however cheap they are
+		static constexpr size_t MaxBatchSize = 256;
+		// The most ranges a test is split into, however many instances it has
+		static constexpr size_t MaxRanges = 65536;
+
 		bool IsScheduled(const TestDefinition* test) const;
+		bool IsRunning(const TestDefinition* test) const;
+		bool IsFinished(const TestDefinition* test) const;
 
+		// When sharded, tests is narrowed down to those in this shard
 		void Run(std::vector<TestContext>& tests, const TestExecutionOptions& options = TestExecutionOptions());
 		void Cancel();
 		void Join();
 
-		std::unordered_set<const TestDefinition*> _tests;
+		TestRunState _state;
 		std::stop_source _stopSource{};
 		std::thread _thread;
 
-		static void RunAll(std::vector<TestContext>& tests, const TestExecutionOptions& options, std::stop_token token);
-		static void RunAsync(std::span<TestContext* const> tests, const TestExecutionOptions& options, std::stop_token token);
-		static void Run(TestContext context, const TestExecutionOptions& options, std::stop_token token);
+		// worker threads are kept alive between tests and sessions
+		TestExecutor _executor;
+		// one thread tracks the timeouts of every running test
+		TestWatchdog _watchdog;
+		// worker processes for TestIsolation::Process and TestIsolation::Zygote
+		TestProcessPool _processPool;
+		// coordinates the worker processes of TestIsolation::Distributed
+		TestDistributor _distributor;
+		// durations of previous sessions, persisted to HistoryFile when it is set
+		TestHistory _history;
+		std::filesystem::path HistoryFile;
+		bool _historyLoaded = false;
+		// samples of each benchmark's accepted run, persisted to BaselineFile when it is set
+		TestBaselines _baselines;
+		std::filesystem::path BaselineFile;
+		bool _baselinesLoaded = false;
+
+		void RunAll(std::vector<TestContext>& tests, const TestExecutionOptions& options, std::stop_token token);
+		void RunShared(std::span<TestContext* const> remainder, std::span<TestContext* const> privelaged, TestResourceLocks& resources, const TestExecutionOptions& options, std::stop_token token);
+		void RunAsync(std::span<TestContext* const> tests, TestResourceLocks& resources, const TestExecutionOptions& options, std::stop_token token);
+		// Returns the job of a test that was abandoned but is still running, whatever it holds is held until it returns
+		TestExecutor::JobHandle Run(TestContext context, const TestExecutionOptions& options, std::stop_token token);
+
+		// Runs the initializers of the test's categories that haven't yet run in this process, outermost first
+		static void Initialize(const TestObject& test);
+
+		// how many ranges of more than one instance were run
+		size_t NumBatches() const { return _numBatches; }
+		size_t NumParkedWorkers() const { return _numParkedWorkers; }
+		size_t NumOversubscriptions() const { return _numOversubscriptions; }
 	private:
-		static void RunInternal(TestContext& context, const TestExecutionOptions& options);
+		friend struct TestForkServer;
+		// Runs every instance in the range, progress is set to each as it starts
+		static void RunInternal(TestContext& context, const TestExecutionOptions& options, std::stop_token token = {}, std::atomic<uint64_t>* progress = nullptr);
+
+		void OnFinish(std::span<const TestContext> tests);
+
+		// The ranges a test with instances is run as, each of them gathered back into its result. Only the cheap
+		// instances of a test run in process share a range, the rest are each run on their own, up to MaxRanges.
+		void Split(TestContext& test, const TestExecutionOptions& options, std::vector<TestContext*>& ranges);
+		std::deque<TestContext> _ranges;
+		std::deque<TestResult> _rangeResults;
 
-		void OnFinish();
+		std::atomic<size_t> _numBatches = 0;
+		std::atomic<size_t> _numParkedWorkers = 0;
+		std::atomic<size_t> _numOversubscriptions = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "TestShard.h"
+
+#include "TestRunner.h"
+#include "TestHistory.h"
+#include "TestDefinition.h"
+
+#include <algorithm>
+#include <string>
+
+namespace lsn::test_framework
+{
+
+namespace
+{
+	// FNV-1a, std::hash isn't guaranteed to be the same between machines or builds
+	uint64_t StableHash(const std::string& key)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char c : key)
+		{
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// The index'th of count slices, as near the same size as they can be, with the first taking any left over
+	InstanceRange Slice(InstanceRange instances, uint64_t index, uint64_t count)
+	{
+		auto size = instances.Size() / count;
+		auto extra = instances.Size() % count;
+		auto begin = instances.Begin + size * index + std::min(index, extra);
+		return { begin, begin + size + (index < extra ? 1 : 0) };
+	}
+}
+
+std::vector<TestContext> TestShard::Select(std::span<const TestContext> tests) const
+{
+	if (!IsSharded())
+		return { tests.begin(), tests.end() };
+
+	std::vector<TestContext> selected;
+	std::vector<TestContext> whole;
+	std::vector<TestContext> parameterized;
+	for (const auto& context : tests)
+	{
+		auto& kind = context.Definition->NumInstances == 0 ? whole : parameterized;
+		kind.push_back(context);
+		// nothing narrowed down yet is all of them
+		if (&kind == &parameterized && context.Instances.Size() == 0)
+			kind.back().Instances = { 0, context.Definition->NumInstances };
+	}
+
+	// Without durations each test's shard depends on nothing but its own key, so adding a test never moves another,
+	// and every shard runs an even slice of a test with instances
+	TestHistory durations;
+	if (DurationsFile.empty() || !durations.Load(DurationsFile))
+	{
+		for (const auto& context : parameterized)
+		{
+			auto slice = context;
+			slice.Instances = Slice(context.Instances, Index, Count);
+			slice.EstimatedDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(context.EstimatedDuration * (double(slice.Instances.Size()) / context.Instances.Size()));
+			if (slice.Instances.Size() > 0)
+				selected.push_back(slice);
+		}
+
+		for (const auto& context : whole)
+		{
+			if (StableHash(TestHistory::KeyOf(*context.Definition->_parent)) % Count == static_cast<uint64_t>(Index))
+				selected.push_back(context);
+		}
+		return selected;
+	}
+
+	// The frozen durations stand in for the estimates, which are left as they were for dispatch. Estimated all
+	// together, as a test without a duration takes after the others.
+	std::vector<TestContext> estimated(whole.begin(), whole.end());
+	estimated.insert(estimated.end(), parameterized.begin(), parameterized.end());
+	durations.Estimate(estimated);
+
+	struct Candidate
+	{
+		int64_t Estimate; // whole milliseconds, so rounding can't differ between machines
+		uint64_t Hash;
+		std::string Key;
+		size_t Test;
+	};
+
+	// an order that only depends on the tests themselves, longest first
+	auto order = [&](std::span<const TestContext> contexts, size_t first)
+	{
+		std::vector<Candidate> candidates;
+		candidates.reserve(contexts.size());
+		for (size_t i = 0; i < contexts.size(); ++i)
+		{
+			auto key = TestHistory::KeyOf(*contexts[i].Definition->_parent);
+			auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(estimated[first + i].EstimatedDuration).count();
+			candidates.push_back({ duration, StableHash(key), std::move(key), i });
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs)
+		{
+			if (lhs.Estimate != rhs.Estimate)
+				return lhs.Estimate > rhs.Estimate;
+			if (lhs.Hash != rhs.Hash)
+				return lhs.Hash < rhs.Hash;
+			return lhs.Key < rhs.Key;
+		});
+		return candidates;
+	};
+
+	// each whole test goes to the shard with the least work so far, the lowest index winning a tie
+	std::vector<double> load(Count, 0.0);
+	for (const auto& candidate : order(whole, 0))
+	{
+		auto shard = std::min_element(load.begin(), load.end()) - load.begin();
+		load[shard] += std::max<int64_t>(candidate.Estimate, 1);
+
+		if (shard == Index)
+			selected.push_back(whole[candidate.Test]);
+	}
+
+	// Then the instances of each parameterized test fill the shards up towards an even share, at what each of them
+	// costs going by the test's duration. Each shard still gets a contiguous slice, in shard order.
+	for (const auto& candidate : order(parameterized, whole.size()))
+	{
+		const auto& context = parameterized[candidate.Test];
+		auto instances = context.Instances;
+		// the duration is of every instance, however many are being run
+		double cost = double(std::max<int64_t>(candidate.Estimate, 1)) / context.Definition->NumInstances;
+
+		double total = cost * instances.Size();
+		for (double shard : load)
+			total += shard;
+		double target = total / Count;
+
+		std::vector<uint64_t> counts(Count, 0);
+		uint64_t remaining = instances.Size();
+		for (int shard = 0; shard < Count && remaining > 0; ++shard)
+		{
+			auto room = std::max(target - load[shard], 0.0);
+			counts[shard] = std::min<uint64_t>(remaining, static_cast<uint64_t>(room / cost));
+			remaining -= counts[shard];
+		}
+
+		// what's left over from rounding down goes one at a time to whichever shard has the least
+		for (; remaining > 0; --remaining)
+		{
+			int least = 0;
+			for (int shard = 1; shard < Count; ++shard)
+			{
+				if (load[shard] + counts[shard] * cost < load[least] + counts[least] * cost)
+					least = shard;
+			}
+			++counts[least];
+		}
+
+		auto begin = instances.Begin;
+		for (int shard = 0; shard < Count; ++shard)
+		{
+			load[shard] += counts[shard] * cost;
+			if (shard == Index && counts[shard] > 0)
+			{
+				auto slice = context;
+				slice.Instances = { begin, begin + counts[shard] };
+				slice.EstimatedDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(context.EstimatedDuration * (double(counts[shard]) / instances.Size()));
+				selected.push_back(slice);
+			}
+			begin += counts[shard];
+		}
+	}
+
+	return selected;
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace lsn::test_framework
+{
+	struct TestContext;
+
+	// One of Count slices of the suite, for splitting a run across machines.
+	// Every shard computes the same partition independently: tests are keyed on their full path rather than
+	// registration order. Each machine's own history changes as it runs, so it's never used to partition.
+	// Given a durations file, a history saved once and handed unchanged to every shard, the shards are balanced
+	// by its durations, otherwise the tests are dealt out by a hash of their key. The runner falls back to its own
+	// history file, which then has to be the same on every shard.
+	// A test with instances is split instead, each shard running its own contiguous slice of them. With durations
+	// the slices are sized by what the instances cost, topping up the shards the whole tests left lightest.
+	struct TestShard
+	{
+		int Index = 0;
+		int Count = 1;
+		std::filesystem::path DurationsFile; // read only, never written by the run
+
+		bool IsSharded() const { return Count > 1; }
+
+		std::vector<TestContext> Select(std::span<const TestContext> tests) const;
+	};
+}
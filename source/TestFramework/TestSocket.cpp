@@ -0,0 +1,284 @@
+#include "TestSocket.h"
+
+#include "TestResult.h"
+
+#include <format>
+#include <string_view>
+#include <type_traits>
+
+#if defined __linux__
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+namespace lsn::test_framework::socket_utils
+{
+
+#if defined __linux__
+
+namespace
+{
+	struct ResultHeader
+	{
+		int64_t TimeStarted;
+		int64_t TimeEnded;
+		int32_t Passed;
+		int32_t LineNumber;
+		uint32_t ErrorLength;
+		uint32_t FileLength;
+		uint32_t MeasurementsLength; // the TestMeasurements follow the file when there are any
+		uint32_t InstancesLength; // then what became of each instance, for a parameterized test
+	};
+
+	template<typename T>
+	void Append(std::string& bytes, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool Take(std::string_view& bytes, T& value)
+	{
+		if (bytes.size() < sizeof(T))
+			return false;
+
+		memcpy(&value, bytes.data(), sizeof(T));
+		bytes.remove_prefix(sizeof(T));
+		return true;
+	}
+
+	bool Take(std::string_view& bytes, std::string& value, size_t length)
+	{
+		if (bytes.size() < length)
+			return false;
+
+		value.assign(bytes.substr(0, length));
+		bytes.remove_prefix(length);
+		return true;
+	}
+
+	// counts, then each of ran, failures and benchmarks as a count followed by their entries
+	std::string Encode(const TestInstanceResults::Snapshot& instances)
+	{
+		std::string bytes;
+		Append(bytes, instances.NumPassed);
+		Append(bytes, instances.NumFailed);
+
+		Append(bytes, (uint64_t)instances.Ran.size());
+		for (auto range : instances.Ran)
+			Append(bytes, range);
+
+		Append(bytes, (uint64_t)instances.Failures.size());
+		for (const auto& [index, failure] : instances.Failures)
+		{
+			Append(bytes, index);
+			Append(bytes, (int32_t)failure.linenumber());
+			Append(bytes, (uint32_t)failure.error().size());
+			Append(bytes, (uint32_t)failure.filename().size());
+			bytes += failure.error();
+			bytes += failure.filename();
+		}
+
+		Append(bytes, (uint64_t)instances.Benchmarks.size());
+		for (const auto& [index, benchmark] : instances.Benchmarks)
+		{
+			Append(bytes, index);
+			Append(bytes, benchmark);
+		}
+		return bytes;
+	}
+
+	bool Decode(std::string_view bytes, TestInstanceResults::Snapshot& instances)
+	{
+		uint64_t count = 0;
+		if (!Take(bytes, instances.NumPassed) || !Take(bytes, instances.NumFailed) || !Take(bytes, count))
+			return false;
+
+		for (InstanceRange range; count > 0; --count)
+		{
+			if (!Take(bytes, range))
+				return false;
+			instances.Ran.push_back(range);
+		}
+
+		if (!Take(bytes, count))
+			return false;
+		for (; count > 0; --count)
+		{
+			uint64_t index = 0;
+			int32_t lineNumber = 0;
+			uint32_t errorLength = 0, fileLength = 0;
+			std::string error, file;
+			if (!Take(bytes, index) || !Take(bytes, lineNumber) || !Take(bytes, errorLength) || !Take(bytes, fileLength)
+				|| !Take(bytes, error, errorLength) || !Take(bytes, file, fileLength))
+				return false;
+			instances.Failures.emplace_back(index, test_failure(error, file, lineNumber));
+		}
+
+		if (!Take(bytes, count))
+			return false;
+		for (; count > 0; --count)
+		{
+			uint64_t index = 0;
+			BenchmarkStatistics benchmark;
+			if (!Take(bytes, index) || !Take(bytes, benchmark))
+				return false;
+			instances.Benchmarks.emplace_back(index, benchmark);
+		}
+		return bytes.empty();
+	}
+}
+
+bool SendAll(int socket, const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		// MSG_NOSIGNAL as a dead worker must not take us down with a SIGPIPE
+		auto sent = send(socket, bytes, size, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+
+		bytes += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+bool ReceiveAll(int socket, void* data, size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+	while (size > 0)
+	{
+		auto received = recv(socket, bytes, size, 0);
+		if (received < 0 && errno == EINTR)
+			continue;
+		if (received <= 0)
+			return false;
+
+		bytes += received;
+		size -= received;
+	}
+	return true;
+}
+
+bool SendWithDescriptor(int socket, const void* data, size_t size, int descriptor)
+{
+	iovec payload{ const_cast<void*>(data), size };
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+	msghdr message{};
+	message.msg_iov = &payload;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	auto* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+
+	return sendmsg(socket, &message, MSG_NOSIGNAL) == (ssize_t)size;
+}
+
+bool ReceiveWithDescriptor(int socket, void* data, size_t size, int& descriptor)
+{
+	iovec payload{ data, size };
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+	msghdr message{};
+	message.msg_iov = &payload;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	ssize_t received;
+	while ((received = recvmsg(socket, &message, 0)) < 0 && errno == EINTR) {}
+	if (received != (ssize_t)size)
+		return false;
+
+	descriptor = -1;
+	if (auto* header = CMSG_FIRSTHDR(&message); header && header->cmsg_type == SCM_RIGHTS)
+		memcpy(&descriptor, CMSG_DATA(header), sizeof(int));
+	return true;
+}
+
+bool SendResult(int socket, const TestResult& result)
+{
+	std::string error, file;
+	int32_t lineNumber = 0;
+	if (auto failure = result.LastFailure())
+	{
+		error = failure->error();
+		file = failure->filename();
+		lineNumber = failure->linenumber();
+	}
+
+	auto measurements = result.Measurements();
+	uint32_t measurementsLength = measurements ? sizeof(TestMeasurements) : 0;
+
+	std::string instances;
+	if (auto recorded = result.Instances())
+		instances = Encode(recorded->Read());
+
+	ResultHeader header{ (int64_t)result.TimeStarted().count(), (int64_t)result.TimeEnded().count(), (int32_t)result.HasPassed(), lineNumber, (uint32_t)error.size(), (uint32_t)file.size(), measurementsLength, (uint32_t)instances.size() };
+
+	// sent in one go, so the reader never sees half a result unless we died part way through
+	std::string message(reinterpret_cast<const char*>(&header), sizeof(header));
+	message += error;
+	message += file;
+	if (measurements)
+		message.append(reinterpret_cast<const char*>(measurements.get()), sizeof(TestMeasurements));
+	message += instances;
+	return SendAll(socket, message.data(), message.size());
+}
+
+bool ReceiveResult(int socket, TestResult& result)
+{
+	ResultHeader header{};
+	std::string error, file;
+	if (!ReceiveAll(socket, &header, sizeof(header)))
+		return false;
+
+	error.resize(header.ErrorLength);
+	file.resize(header.FileLength);
+	if (!ReceiveAll(socket, error.data(), error.size()) || !ReceiveAll(socket, file.data(), file.size()))
+		return false;
+
+	TestMeasurements measurements;
+	if (header.MeasurementsLength != 0 && (header.MeasurementsLength != sizeof(measurements) || !ReceiveAll(socket, &measurements, sizeof(measurements))))
+		return false;
+
+	std::string bytes(header.InstancesLength, '\0');
+	TestInstanceResults::Snapshot instances;
+	if (!ReceiveAll(socket, bytes.data(), bytes.size()) || (!bytes.empty() && !Decode(bytes, instances)))
+		return false;
+
+	result.Begin(std::chrono::nanoseconds(header.TimeStarted));
+	if (!header.Passed)
+		result.SetFailure(test_failure(error, file, header.LineNumber));
+	if (header.MeasurementsLength != 0)
+		result.SetMeasurements(measurements);
+	if (!bytes.empty())
+		result.SetInstances(instances);
+	result.End(std::chrono::nanoseconds(header.TimeEnded));
+	return true;
+}
+
+std::string DescribeExit(int status)
+{
+	if (WIFSIGNALED(status))
+		return std::format("worker process crashed with signal {} ({})", WTERMSIG(status), strsignal(WTERMSIG(status)));
+	if (WIFEXITED(status))
+		return std::format("worker process exited with code {}", WEXITSTATUS(status));
+	return "worker process was lost";
+}
+
+#endif
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace lsn::test_framework
+{
+	struct TestResult;
+}
+
+// Blocking helpers for talking to worker processes over unix sockets, only available where fork is
+namespace lsn::test_framework::socket_utils
+{
+#if defined __linux__
+	bool SendAll(int socket, const void* data, size_t size);
+	bool ReceiveAll(int socket, void* data, size_t size);
+
+	// Passes a descriptor along with the data
+	bool SendWithDescriptor(int socket, const void* data, size_t size, int descriptor);
+	bool ReceiveWithDescriptor(int socket, void* data, size_t size, int& descriptor);
+
+	// A finished test's result, including its failure if it has one
+	bool SendResult(int socket, const TestResult& result);
+	bool ReceiveResult(int socket, TestResult& result);
+
+	// Describes the status returned by waitpid for a worker that went away
+	std::string DescribeExit(int status);
+#endif
+}
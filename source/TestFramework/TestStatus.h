@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// TODO: Remove and use an expose macro for the imgui
+#include <XEnum.h>
+
+// Ordered by precedence, a category takes the highest status of any of its tests
+ImplementXEnum(TestResultStatus,
+	XValue(Passed),
+	XValue(NotRun),
+	XValue(Failed),
+	XValue(WaitingToRun),
+	XValue(Running)
+)
+
+namespace lsn::test_framework
+{
+	// How many tests below a node are in each status. Kept up to date as tests change status, so a category
+	// can be drawn without visiting its tests. Counts are updated independently, so while tests are running
+	// a reader can briefly see a test counted in both its old and new status (or neither).
+	class TestStatusCounts
+	{
+	public:
+		uint32_t operator[](TestResultStatus status) const
+		{
+			return _counts[static_cast<size_t>(status)].load(std::memory_order_relaxed);
+		}
+
+		void Add(TestResultStatus status, int32_t count)
+		{
+			_counts[static_cast<size_t>(status)].fetch_add(count, std::memory_order_relaxed);
+		}
+
+		void Add(const TestStatusCounts& other)
+		{
+			for (size_t i = 0; i < _counts.size(); ++i)
+				_counts[i].fetch_add(other._counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+
+		uint32_t Total() const
+		{
+			uint32_t total = 0;
+			for (const auto& count : _counts)
+				total += count.load(std::memory_order_relaxed);
+			return total;
+		}
+
+		// The highest status of any test, an empty node has nothing stopping it from passing
+		TestResultStatus Aggregate() const
+		{
+			for (size_t i = _counts.size(); i-- > 0; )
+			{
+				if (_counts[i].load(std::memory_order_relaxed) != 0)
+					return static_cast<TestResultStatus>(i);
+			}
+
+			return TestResultStatus::Passed;
+		}
+
+	private:
+		std::array<std::atomic<uint32_t>, XEnumTraits<TestResultStatus>::Count> _counts{};
+	};
+}
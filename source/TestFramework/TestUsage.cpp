@@ -0,0 +1,95 @@
+#include "TestUsage.h"
+
+#include <algorithm>
+
+#if defined __linux__
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace lsn::test_framework
+{
+
+#if defined __linux__
+
+std::optional<ResourceUsage> TestUsage::Start()
+{
+	timespec wall, cpu;
+	rusage usage;
+	if (clock_gettime(CLOCK_MONOTONIC, &wall) != 0 || clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) != 0 || getrusage(RUSAGE_THREAD, &usage) != 0)
+		return std::nullopt;
+
+	auto toDuration = [](const timespec& time) { return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec); };
+
+	ResourceUsage sample;
+	sample.WallTime = toDuration(wall);
+	sample.CpuTime = toDuration(cpu);
+	sample.MinorFaults = usage.ru_minflt;
+	sample.MajorFaults = usage.ru_majflt;
+	sample.VoluntarySwitches = usage.ru_nvcsw;
+	sample.InvoluntarySwitches = usage.ru_nivcsw;
+	return sample;
+}
+
+std::optional<ResourceUsage> TestUsage::Stop(const std::optional<ResourceUsage>& start)
+{
+	if (!start)
+		return std::nullopt;
+
+	auto end = Start();
+	if (!end)
+		return std::nullopt;
+
+	ResourceUsage usage;
+	usage.WallTime = end->WallTime - start->WallTime;
+	usage.CpuTime = end->CpuTime - start->CpuTime;
+	usage.MinorFaults = end->MinorFaults - start->MinorFaults;
+	usage.MajorFaults = end->MajorFaults - start->MajorFaults;
+	usage.VoluntarySwitches = end->VoluntarySwitches - start->VoluntarySwitches;
+	usage.InvoluntarySwitches = end->InvoluntarySwitches - start->InvoluntarySwitches;
+	return usage;
+}
+
+#else
+
+std::optional<ResourceUsage> TestUsage::Start()
+{
+	return std::nullopt;
+}
+
+std::optional<ResourceUsage> TestUsage::Stop(const std::optional<ResourceUsage>&)
+{
+	return std::nullopt;
+}
+
+#endif
+
+void OversubscriptionMonitor::Record(const ResourceUsage& usage)
+{
+	// waiting on anything, a lock or the disk included, makes the share meaningless
+	if (usage.VoluntarySwitches != 0 || usage.MajorFaults != 0 || _threshold <= 0.0)
+		return;
+
+	std::lock_guard lock(_mutex);
+	_windowWall += usage.WallTime;
+	_windowCpu += usage.CpuTime;
+	if (_windowWall < Window)
+		return;
+
+	double share = static_cast<double>(_windowCpu.count()) / _windowWall.count();
+	if (share < _threshold)
+	{
+		_numOversubscribed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (share < _threshold && _park)
+	{
+		auto active = _activeWorkers.load(std::memory_order_relaxed);
+		_activeWorkers.store(std::max(active - 1, 1), std::memory_order_relaxed);
+	}
+
+	_windowWall = std::chrono::nanoseconds(0);
+	_windowCpu = std::chrono::nanoseconds(0);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+
+// What running a test cost its thread, from CLOCK_THREAD_CPUTIME_ID and getrusage(RUSAGE_THREAD) on Linux.
+// Wall time alone can't tell a test that waits from one that computes, nor one that computes from one that
+// was kept off the cpu by too many workers.
+namespace lsn::test_framework
+{
+	struct ResourceUsage
+	{
+		std::chrono::nanoseconds WallTime{ 0 };
+		std::chrono::nanoseconds CpuTime{ 0 };
+		uint64_t MinorFaults = 0;
+		uint64_t MajorFaults = 0; // had to wait on the disk
+		uint64_t VoluntarySwitches = 0; // gave up the cpu to wait on something
+		uint64_t InvoluntarySwitches = 0; // had the cpu taken away
+
+		// The share of its wall time the thread spent on the cpu
+		double CpuShare() const
+		{
+			return WallTime.count() > 0 ? static_cast<double>(CpuTime.count()) / WallTime.count() : 0.0;
+		}
+	};
+
+	static_assert(std::is_trivially_copyable_v<ResourceUsage>);
+
+	struct TestUsage
+	{
+		// Where the calling thread stands, nothing where the platform can't tell
+		static std::optional<ResourceUsage> Start();
+
+		// The usage of the calling thread since start
+		static std::optional<ResourceUsage> Stop(const std::optional<ResourceUsage>& start);
+	};
+
+	// Spots the workers getting less of the cpu than they could use. Only tests that never blocked say anything,
+	// one that didn't wait on anything and still had a small share of the cpu was waiting for a core. Each window
+	// where that holds the workers are oversubscribed, and when parking the last of them is parked. Never goes
+	// back up within a session, nor below one worker.
+	class OversubscriptionMonitor
+	{
+	public:
+		// the compute bound time the share is judged over
+		static constexpr std::chrono::milliseconds Window{ 50 };
+
+		OversubscriptionMonitor(int numWorkers, double threshold, bool park)
+			: _activeWorkers(numWorkers)
+			, _threshold(threshold)
+			, _park(park)
+		{}
+
+		void Record(const ResourceUsage& usage);
+
+		// Workers numbered at or above this should stop taking tests
+		int ActiveWorkers() const { return _activeWorkers.load(std::memory_order_relaxed); }
+		// The windows the workers were found oversubscribed in
+		size_t NumOversubscribed() const { return _numOversubscribed.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<int> _activeWorkers;
+		std::atomic<size_t> _numOversubscribed{ 0 };
+		double _threshold;
+		bool _park;
+
+		std::mutex _mutex;
+		std::chrono::nanoseconds _windowWall{ 0 };
+		std::chrono::nanoseconds _windowCpu{ 0 };
+	};
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Value sources that are enumerated by index rather than built up front. Each is a random access sequence of
+// argument tuples, so combining them never materializes the combinations and any one instance of a parameterized
+// test can be created, or run, on its own.
+namespace lsn::test_framework::values
+{
+	template<typename Source>
+	concept IndexedSource = requires(const Source& source, size_t index)
+	{
+		{ source.size() } -> std::convertible_to<size_t>;
+		source[index];
+	};
+
+	namespace details
+	{
+		template<typename T> struct is_tuple : std::false_type {};
+		template<typename... T> struct is_tuple<std::tuple<T...>> : std::true_type {};
+
+		template<typename T>
+		auto AsTuple(const T& value)
+		{
+			if constexpr (is_tuple<T>::value)
+				return value;
+			else
+				return std::tuple<T>(value);
+		}
+	}
+
+	// The values of a vector, as either vector<T> or vector<tuple<T...>>
+	template<typename T>
+	class VectorSource
+	{
+	public:
+		explicit VectorSource(std::vector<T> values)
+			: _values(std::make_shared<const std::vector<T>>(std::move(values)))
+		{}
+
+		size_t size() const { return _values->size(); }
+		auto operator[](size_t index) const { return details::AsTuple((*_values)[index]); }
+
+	private:
+		std::shared_ptr<const std::vector<T>> _values; // shared, as sources are copied into every instance
+	};
+
+	// begin, begin + step, ... up to but not including end. Only counts up, a step that isn't positive is empty.
+	template<std::integral T>
+	class RangeSource
+	{
+	public:
+		RangeSource(T begin, T end, T step)
+			: _begin(begin), _end(end), _step(step)
+		{}
+
+		// unsigned, so neither the distance nor the rounding can overflow, even across the whole of T
+		size_t size() const
+		{
+			using Unsigned = std::make_unsigned_t<T>;
+			if (_step <= 0 || _end <= _begin)
+				return 0;
+
+			Unsigned distance = static_cast<Unsigned>(static_cast<Unsigned>(_end) - static_cast<Unsigned>(_begin));
+			return static_cast<size_t>((distance - 1) / static_cast<Unsigned>(_step)) + 1;
+		}
+
+		auto operator[](size_t index) const
+		{
+			using Unsigned = std::make_unsigned_t<T>;
+			return std::tuple<T>(static_cast<T>(static_cast<Unsigned>(_begin) + static_cast<Unsigned>(index) * static_cast<Unsigned>(_step)));
+		}
+
+	private:
+		T _begin;
+		T _end;
+		T _step;
+	};
+
+	// Every combination of the sources, the last varying fastest as if they were nested loops
+	template<IndexedSource... Sources>
+	class ProductSource
+	{
+	public:
+		explicit ProductSource(Sources... sources)
+			: _sources(std::move(sources)...)
+		{}
+
+		// Throws std::overflow_error when there are more combinations than a size_t can count, rather than wrap
+		// around to far fewer of them
+		size_t size() const
+		{
+			const std::array<size_t, sizeof...(Sources)> sizes = std::apply([](const auto&... sources) { return std::array<size_t, sizeof...(Sources)>{ static_cast<size_t>(sources.size())... }; }, _sources);
+			if (std::find(sizes.begin(), sizes.end(), 0) != sizes.end())
+				return 0;
+
+			size_t size = 1;
+			for (auto next : sizes)
+			{
+				if (size > std::numeric_limits<size_t>::max() / next)
+					throw std::overflow_error("too many combinations to count");
+				size *= next;
+			}
+			return size;
+		}
+
+		auto operator[](size_t index) const
+		{
+			return At(index, std::index_sequence_for<Sources...>());
+		}
+
+	private:
+		template<size_t... I>
+		auto At(size_t index, std::index_sequence<I...>) const
+		{
+			const std::array<size_t, sizeof...(I)> sizes{ std::get<I>(_sources).size()... };
+
+			std::array<size_t, sizeof...(I)> digits{};
+			for (size_t i = sizes.size(); i-- > 0; )
+			{
+				digits[i] = index % sizes[i];
+				index /= sizes[i];
+			}
+
+			return std::tuple_cat(std::get<I>(_sources)[digits[I]]...);
+		}
+
+		std::tuple<Sources...> _sources;
+	};
+
+	// The sources side by side, as long as the shortest of them
+	template<IndexedSource... Sources>
+	class ZipSource
+	{
+	public:
+		explicit ZipSource(Sources... sources)
+			: _sources(std::move(sources)...)
+		{}
+
+		size_t size() const
+		{
+			return std::apply([](const auto&... sources) { return std::min({ static_cast<size_t>(sources.size())... }); }, _sources);
+		}
+
+		auto operator[](size_t index) const
+		{
+			return std::apply([index](const auto&... sources) { return std::tuple_cat(sources[index]...); }, _sources);
+		}
+
+	private:
+		std::tuple<Sources...> _sources;
+	};
+
+	// The values returned by a function, the same functions ValueSource takes
+	template<typename Func>
+	auto ValueSource(Func&& func)
+	{
+		return VectorSource(std::invoke(std::forward<Func>(func)));
+	}
+
+	template<typename T, typename... Ts>
+	auto Values(T first, Ts... rest)
+	{
+		return VectorSource(std::vector<T>{ first, static_cast<T>(rest)... });
+	}
+
+	template<std::integral T>
+	auto Range(T begin, T end, T step = 1)
+	{
+		return RangeSource<T>(begin, end, step);
+	}
+
+	template<IndexedSource... Sources>
+	auto Combine(Sources... sources)
+	{
+		return ProductSource<Sources...>(std::move(sources)...);
+	}
+
+	template<IndexedSource... Sources>
+	auto Zip(Sources... sources)
+	{
+		return ZipSource<Sources...>(std::move(sources)...);
+	}
+}
@@ -0,0 +1,81 @@
+#include "TestWatchdog.h"
+
+namespace lsn::test_framework
+{
+
+TestWatchdog::~TestWatchdog()
+{
+	{
+		std::lock_guard lock(_mutex);
+		_shutdown = true;
+	}
+	_deadlinesChanged.notify_all();
+
+	if (_thread.joinable())
+		_thread.join();
+}
+
+TestWatchdog::Ticket TestWatchdog::Watch(const TestExecutor::JobHandle& job, std::chrono::milliseconds timeout, Event raise)
+{
+	auto deadline = Clock::now() + timeout;
+	bool earliest = false;
+
+	Ticket ticket{ {}, job, raise };
+	{
+		std::lock_guard lock(_mutex);
+
+		// started lazily so that an unused runner costs nothing
+		if (!_thread.joinable())
+			_thread = std::thread(&TestWatchdog::Process, this);
+
+		ticket.Entry = _deadlines.emplace(deadline, Deadline{ job, raise });
+		earliest = ticket.Entry == _deadlines.begin();
+	}
+
+	// only need to wake the watchdog if it's currently sleeping past our deadline
+	if (earliest)
+		_deadlinesChanged.notify_one();
+
+	return ticket;
+}
+
+void TestWatchdog::Unwatch(const Ticket& ticket)
+{
+	std::lock_guard lock(_mutex);
+
+	// expired entries have already been removed by the watchdog
+	if (!ticket.Job->Has(ticket.Raise))
+		_deadlines.erase(ticket.Entry);
+}
+
+size_t TestWatchdog::NumWatched() const
+{
+	std::lock_guard lock(_mutex);
+	return _deadlines.size();
+}
+
+void TestWatchdog::Process()
+{
+	std::unique_lock lock(_mutex);
+	while (!_shutdown)
+	{
+		if (_deadlines.empty())
+		{
+			_deadlinesChanged.wait(lock);
+			continue;
+		}
+
+		auto now = Clock::now();
+		while (!_deadlines.empty() && _deadlines.begin()->first <= now)
+		{
+			const auto& [job, raise] = _deadlines.begin()->second;
+			job->Notify(raise);
+			_deadlines.erase(_deadlines.begin());
+		}
+
+		if (!_deadlines.empty())
+			_deadlinesChanged.wait_until(lock, _deadlines.begin()->first);
+	}
+}
+
+}
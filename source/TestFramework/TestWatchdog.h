@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "TestExecutor.h"
+
+namespace lsn::test_framework
+{
+	// A single thread that tracks the deadline of every in-flight job.
+	// It sleeps until the earliest deadline and raises Expired (or the given event) on any job that reaches it,
+	// so waiting on a test never costs a core.
+	struct TestWatchdog
+	{
+		using Clock = std::chrono::steady_clock;
+		using Event = TestExecutor::Job::Event;
+
+		struct Deadline
+		{
+			TestExecutor::JobHandle Job;
+			Event Raise;
+		};
+
+		using Deadlines = std::multimap<Clock::time_point, Deadline>;
+
+		struct Ticket
+		{
+			Deadlines::iterator Entry;
+			TestExecutor::JobHandle Job;
+			Event Raise;
+		};
+
+		TestWatchdog() = default;
+		TestWatchdog(const TestWatchdog&) = delete;
+		~TestWatchdog();
+
+		// Raises the event on the job once the timeout has passed, unless it's unwatched first
+		Ticket Watch(const TestExecutor::JobHandle& job, std::chrono::milliseconds timeout, Event raise = Event::Expired);
+
+		// Stops tracking the job, must be called once for every ticket
+		void Unwatch(const Ticket& ticket);
+
+		size_t NumWatched() const;
+
+	private:
+		void Process();
+
+		mutable std::mutex _mutex;
+		std::condition_variable _deadlinesChanged;
+		Deadlines _deadlines;
+		std::thread _thread;
+		bool _shutdown = false;
+	};
+}
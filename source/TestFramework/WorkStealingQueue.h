@@ -0,0 +1,53 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace lsn::test_framework
+{
+	// A deque owned by a single worker. The owner takes from the front,
+	// while any other worker that has run dry steals from the back.
+	template<typename T>
+	class WorkStealingQueue
+	{
+	public:
+		void Push(T item)
+		{
+			std::lock_guard lock(_mutex);
+			_items.push_back(std::move(item));
+		}
+
+		std::optional<T> Pop()
+		{
+			std::lock_guard lock(_mutex);
+			if (_items.empty())
+				return std::nullopt;
+
+			T item = std::move(_items.front());
+			_items.pop_front();
+			return item;
+		}
+
+		std::optional<T> Steal()
+		{
+			std::lock_guard lock(_mutex);
+			if (_items.empty())
+				return std::nullopt;
+
+			T item = std::move(_items.back());
+			_items.pop_back();
+			return item;
+		}
+
+		size_t Size() const
+		{
+			std::lock_guard lock(_mutex);
+			return _items.size();
+		}
+
+	private:
+		mutable std::mutex _mutex;
+		std::deque<T> _items;
+	};
+}
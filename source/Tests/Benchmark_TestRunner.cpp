@@ -0,0 +1,359 @@
+
+#include "TestFramework/TestFramework.h"
+#include "SyntheticSuite.h"
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+
+using namespace lsn::test_framework;
+
+namespace FrameworkBenchmarks::Helpers
+{
+	// Each variant of a benchmark is an instance, whose statistics are kept with its result and held to a
+	// baseline of their own. Short, as every iteration runs a whole suite.
+	inline const BenchmarkOptions Sampling{ std::chrono::milliseconds(20), std::chrono::milliseconds(250) };
+
+	// How the runner used to dispatch each test, a thread of its own polled until it set a flag or ran out of time
+	void RunOnOwnThread(TestContext& context, const TestExecutionOptions& options)
+	{
+		auto timeout = context.DetermineTimeout(options);
+
+		std::atomic<bool> complete{ false };
+		std::thread thread([&context, &complete]()
+		{
+			context.Result->Reset();
+			context.Result->Begin(std::chrono::high_resolution_clock::now().time_since_epoch());
+			try
+			{
+				std::invoke(context.Definition->_test);
+			}
+			catch (const test_failure& failure)
+			{
+				context.Result->SetFailure(failure);
+			}
+			context.Result->End(std::chrono::high_resolution_clock::now().time_since_epoch());
+			complete = true;
+		});
+
+		auto start = std::chrono::high_resolution_clock::now();
+		while (!complete && std::chrono::high_resolution_clock::now() - start < timeout)
+		{}
+
+		thread.join();
+	}
+
+	std::unique_ptr<TestObject> GenerateTrivialTest()
+	{
+		return TestGenerator<void()>([]() {}, "Trivial", __FILE__, __LINE__).Generate();
+	}
+}
+
+// Benchmarks are exclusive so they are not skewed by the rest of the suite. Each runs whole suites so they're
+// explicit, left out of RunAll and only run along with their category.
+DeclareTestCategory(FrameworkBenchmarks)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+	using namespace FrameworkBenchmarks::Helpers;
+
+	constexpr size_t NumDispatchTests = 1000;
+
+	// The cost of dispatching a suite of trivial tests, which was previously a thread per test
+	DeclareTest(PerTestOverhead, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values("thread per test", "first session", "reused session")), Arguments(const char* dispatch))
+	{
+		SyntheticSuite suite(NumDispatchTests, []() {});
+		auto options = TestExecutionOptions().ForceOntoMainThread();
+		std::string_view variant = dispatch;
+
+		TestRunner reused;
+		TestBenchmark::Run([&]()
+		{
+			auto contexts = suite.Contexts();
+			if (variant == "thread per test")
+			{
+				for (auto& context : contexts)
+					RunOnOwnThread(context, options);
+			}
+			else if (variant == "first session")
+			{
+				TestRunner runner;
+				runner.Run(contexts, options);
+			}
+			else
+			{
+				reused.Run(contexts, options);
+			}
+		}, Sampling);
+
+		AssertThat(suite.AllPassed());
+
+		// the workers should be reused rather than recreated for every test
+		AssertThat(reused._executor.NumWorkers() < NumDispatchTests);
+
+		// every finished test should have released its deadline
+		AssertThat(reused._watchdog.NumWatched() == 0);
+	}
+
+	// Mirrors the privileged and any cohorts of FrameworkConcurrency, scaled down to microseconds.
+	// Every tenth test is much longer so a static split of the work would leave workers idle.
+	DeclareTest(RunAllScaling, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(120s),
+		Combine(Values(1, 2, 4, 8)), Arguments(int numThreads))
+	{
+		SyntheticSuite suite;
+		for (int i = 0; i < 20; ++i)
+			suite.Add(1, [i]() { Spin(200us * (1 + i % 4)); }, TestConcurrency::Privileged);
+		for (int i = 0; i < 100; ++i)
+			suite.Add(1, [i]() { Spin(i % 10 == 0 ? 5000us : 200us); });
+
+		TestExecutionOptions options;
+		options.MaxNumberOfSimultaneousThreads = numThreads;
+		options.MinimumNumberOfTestsPerThread = 1;
+
+		TestRunner runner;
+		TestBenchmark::Run([&]()
+		{
+			auto contexts = suite.Contexts();
+			runner.Run(contexts, options);
+			runner.Join();
+		}, Sampling);
+
+		AssertThat(suite.AllPassed());
+	}
+
+	// Registered, as only those can be run in a worker process
+	DeclareTestSubCategory(FrameworkBenchmarks, Targets)
+	{
+		DeclareTest(Trivial, Explicit(), Combine(Range(0, 100)), Arguments(int _))
+		{
+		}
+	}
+
+	// What each isolation level costs for a trivial test
+	DeclareTest(IsolationOverhead, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values("thread", "process", "zygote", "distributed")), Arguments(const char* level))
+	{
+		constexpr std::pair<std::string_view, TestIsolation> Levels[] = {
+			{ "thread", TestIsolation::Thread }, { "process", TestIsolation::Process },
+			{ "zygote", TestIsolation::Zygote }, { "distributed", TestIsolation::Distributed } };
+
+		auto isolation = std::find_if(std::begin(Levels), std::end(Levels), [&](const auto& named) { return named.first == level; })->second;
+		if (isolation != TestIsolation::Thread && !TestProcessPool::IsSupported())
+			return;
+
+		RegisteredSuite suite;
+		suite.Add("FrameworkBenchmarks/Targets/Trivial");
+
+		TestRunner runner;
+		auto options = TestExecutionOptions().ForceOntoMainThread();
+		options.Isolation = isolation;
+
+		TestBenchmark::Run([&]()
+		{
+			auto contexts = suite.Contexts();
+			runner.Run(contexts, options);
+		}, Sampling);
+
+		AssertThat(suite.AllPassed());
+	}
+
+	// A handful of long tests registered last, which previously became the tail of every run.
+	// A runner without any history runs them in registration order, one with history longest first.
+	DeclareTest(LongestFirstOrdering, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values("registration order", "longest first")), Arguments(const char* order))
+	{
+		SyntheticSuite suite;
+		suite.Add(60, []() { std::this_thread::sleep_for(2ms); });
+		suite.Add(4, []() { std::this_thread::sleep_for(40ms); });
+
+		TestExecutionOptions options;
+		options.MaxNumberOfSimultaneousThreads = 4;
+		options.MinimumNumberOfTestsPerThread = 1;
+
+		auto run = [&](TestRunner& runner)
+		{
+			auto contexts = suite.Contexts();
+			runner.Run(contexts, options);
+			runner.Join();
+		};
+
+		bool withHistory = std::string_view(order) == "longest first";
+		TestRunner experienced;
+		if (withHistory)
+			run(experienced);
+
+		TestBenchmark::Run([&]()
+		{
+			if (withHistory)
+			{
+				run(experienced);
+			}
+			else
+			{
+				TestRunner runner;
+				run(runner);
+			}
+		}, Sampling);
+
+		AssertThat(suite.AllPassed());
+	}
+
+	// Tests that each need exclusive access to one of a few resources, run as an exclusive phase or packed by resource
+	DeclareTest(ResourcePacking, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values("exclusive", "packed by resource")), Arguments(const char* scheduling))
+	{
+		constexpr int NumTests = 32;
+
+		TestExecutionOptions options;
+		options.MaxNumberOfSimultaneousThreads = 4;
+		options.MinimumNumberOfTestsPerThread = 1;
+
+		bool packed = std::string_view(scheduling) == "packed by resource";
+		SyntheticSuite suite;
+		for (int i = 0; i < NumTests; ++i)
+		{
+			if (packed)
+				suite.Add(1, []() { std::this_thread::sleep_for(2ms); }, TestConcurrency::Any, { { std::format("port-{}", i % 4), 1 } });
+			else
+				suite.Add(1, []() { std::this_thread::sleep_for(2ms); }, TestConcurrency::Exclusive);
+		}
+
+		TestRunner runner;
+		TestBenchmark::Run([&]()
+		{
+			auto contexts = suite.Contexts();
+			runner.Run(contexts, options);
+			runner.Join();
+		}, Sampling);
+
+		AssertThat(suite.AllPassed());
+	}
+
+	// Visiting every test of a large suite through the tree against a scan of the flattened registry
+	DeclareTest(RegistryTraversal, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values("registry build", "tree traversal", "registry traversal")), Arguments(const char* traversal))
+	{
+		constexpr size_t NumGroups = 1000;
+		constexpr size_t NumTestsPerGroup = 100;
+		constexpr size_t NumTests = NumGroups * NumTestsPerGroup;
+
+		TestObject root("Root");
+		for (size_t i = 0; i < NumGroups; ++i)
+		{
+			auto* group = root.Add(std::make_unique<TestObject>(std::format("Group({})", i)));
+			for (size_t j = 0; j < NumTestsPerGroup; ++j)
+				group->Add(std::make_unique<TestObject>(std::format("Test({})", j), std::make_unique<TestDefinition>([]() {})));
+		}
+
+		TestRegistry registry;
+		registry.Add(root);
+
+		std::string_view variant = traversal;
+		size_t visited = 0;
+		TestBenchmark::Run([&]()
+		{
+			visited = 0;
+			if (variant == "registry build")
+				TestRegistry().Add(root);
+			else if (variant == "tree traversal")
+				root.VisitAllTests([&](const TestDefinition*) { ++visited; });
+			else
+				registry.ForEachTest([&](const TestDefinition*) { ++visited; });
+			DoNotOptimize(visited);
+		}, Sampling);
+
+		AssertThat(visited == (variant == "registry build" ? 0 : NumTests));
+	}
+
+	// What declaring a test costs. Each used to be generated during static initialization, now the declaration is
+	// constant data and nothing runs before main. Generating the tests is the same work either way, it just moves to
+	// when the tree is first used, so that's measured apart from what lazy registration adds on top: scanning the
+	// sections and putting the records back into declaration order. There a bare test stands in for generating one.
+	DeclareTest(StartupRegistration, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values("generation", "lazy scan and ordering")), Arguments(const char* stage))
+	{
+		constexpr size_t NumTests = 10000;
+
+		static constexpr TestCategoryRegistration category{ "Lazy" };
+		std::vector<TestRegistration> records;
+		std::vector<const TestRegistration*> pointers;
+		records.reserve(NumTests);
+		for (size_t i = 0; i < NumTests; ++i)
+			pointers.push_back(&records.emplace_back(TestRegistration{ &category, __FILE__, (int)i, []() { return std::make_unique<TestObject>("Bare", std::make_unique<TestDefinition>([]() {})); } }));
+
+		// the linker's order isn't the declaration order
+		std::reverse(pointers.begin(), pointers.end());
+		const TestCategoryRegistration* categories[] = { &category };
+
+		bool generating = std::string_view(stage) == "generation";
+		size_t numTests = 0;
+		TestBenchmark::Run([&]()
+		{
+			if (generating)
+			{
+				TestObject eager("Eager");
+				for (size_t i = 0; i < NumTests; ++i)
+					eager.Add(GenerateTrivialTest());
+				numTests = eager.Children.size();
+			}
+			else
+			{
+				std::deque<TestObject> roots;
+				BuildTestTree(categories, pointers, roots);
+				numTests = roots.size() == 1 ? roots.front().Children.size() : 0;
+			}
+		}, Sampling);
+
+		AssertThat(numTests == NumTests);
+	}
+
+	// A parameterized test with a large value source, which only costs anything once it's expanded
+	DeclareTest(ParameterizedExpansion, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values("registration", "registration and expansion")), Arguments(const char* stage))
+	{
+		constexpr int NumInstances = 100000;
+
+		bool expanding = std::string_view(stage) == "registration and expansion";
+		std::unique_ptr<TestObject> test;
+		TestBenchmark::Run([&]()
+		{
+			test = TestGenerator<void(int, int)>([](int, int) {}, "Parameterized", __FILE__, __LINE__)
+				.AddTestsFromSource([]()
+				{
+					std::vector<std::tuple<int, int>> values;
+					for (int i = 0; i < NumInstances; ++i)
+						values.emplace_back(i, i * 2);
+					return values;
+				})
+				.Generate();
+
+			if (expanding)
+				test->Expand();
+		}, Sampling);
+
+		if (expanding)
+			AssertThat(test->Children.size() == 1 && test->Children[0]->Definition->NumInstances == NumInstances);
+	}
+
+	// Trivial instances of a parameterized test, each dispatched as a job of its own or run in batches
+	DeclareTest(BatchedInstances, WithConcurrency(TestConcurrency::Exclusive), Explicit(), Timeout(60s),
+		Combine(Values(0, 1000)), Arguments(int batchMicroseconds))
+	{
+		constexpr int NumInstances = 10000;
+
+		TestRunner runner;
+		SyntheticInstances instances(runner, NumInstances, 1us, [](int) {});
+
+		auto options = TestExecutionOptions().ForceOntoMainThread();
+		options.BatchDuration = std::chrono::microseconds(batchMicroseconds);
+		TestBenchmark::Run([&]()
+		{
+			auto contexts = instances.Contexts();
+			runner.Run(contexts, options);
+		}, Sampling);
+
+		AssertThat(instances.Result.HasRun() && instances.Result.HasPassed());
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "TestFramework/TestFramework.h"
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace FrameworkTests::Helpers
+{
+	using namespace lsn::test_framework;
+
+	// A suite of tests that live outside of the TestManager so the runner can be exercised in isolation
+	struct SyntheticSuite
+	{
+		TestObject Root{ "SyntheticSuite" };
+		std::vector<TestResult> Results;
+
+		SyntheticSuite() = default;
+		SyntheticSuite(size_t numTests, const std::function<void()>& test)
+		{
+			Add(numTests, test);
+		}
+
+		void Add(size_t numTests, const std::function<void()>& test, TestConcurrency concurrency = TestConcurrency::Any, const std::vector<TestResource>& resources = {})
+		{
+			for (size_t i = 0; i < numTests; ++i)
+			{
+				auto definition = std::make_unique<TestDefinition>(test);
+				definition->Concurrency = concurrency;
+				definition->Resources = resources;
+				definition->Index = (uint32_t)Root.Children.size();
+				Root.Add(std::make_unique<TestObject>(std::format("Synthetic({})", Root.Children.size()), std::move(definition)));
+			}
+			Results.resize(Root.Children.size());
+		}
+
+		std::vector<TestContext> Contexts()
+		{
+			std::vector<TestContext> contexts;
+			contexts.reserve(Root.Children.size());
+			for (size_t i = 0; i < Root.Children.size(); ++i)
+				contexts.emplace_back(Root.Children[i]->Definition.get(), &Results[i]);
+			return contexts;
+		}
+
+		bool AllPassed() const
+		{
+			return std::all_of(Results.begin(), Results.end(), [](const auto& result) { return result.HasRun() && result.HasPassed(); });
+		}
+	};
+
+	// Registered tests picked out of a tree of their own, built from the registrations like the manager's. A worker
+	// process only runs registered tests, finding them by path in its own tree, and the manager's tree is left alone.
+	struct RegisteredSuite
+	{
+		std::deque<TestObject> Categories;
+		std::vector<const TestDefinition*> Tests;
+		std::vector<TestResult> Results;
+
+		RegisteredSuite()
+		{
+			BuildTestTree(RegisteredCategories(), RegisteredTests(), Categories);
+		}
+
+		// The test at the path, or that of every source of a parameterized one
+		void Add(const std::string& key)
+		{
+			auto* object = FindTest(Categories, key);
+			AssertThat(object != nullptr);
+
+			object->Expand();
+			object->VisitAllTests([&](const TestDefinition* test)
+			{
+				const_cast<TestDefinition*>(test)->Index = (uint32_t)Tests.size();
+				Tests.push_back(test);
+			});
+			Results.resize(Tests.size());
+		}
+
+		std::vector<TestContext> Contexts()
+		{
+			std::vector<TestContext> contexts;
+			contexts.reserve(Tests.size());
+			for (size_t i = 0; i < Tests.size(); ++i)
+				contexts.emplace_back(Tests[i], &Results[i]);
+			return contexts;
+		}
+
+		bool AllPassed() const
+		{
+			return std::all_of(Results.begin(), Results.end(), [](const auto& result) { return result.HasRun() && result.HasPassed(); });
+		}
+	};
+
+	// A parameterized test over Range(0, numInstances), as it'd be registered, with a history that has each of its
+	// instances taking estimate so the runner will run them in ranges
+	struct SyntheticInstances
+	{
+		std::unique_ptr<TestObject> Test;
+		TestResult Result;
+
+		SyntheticInstances(TestRunner& runner, int numInstances, std::chrono::nanoseconds estimate, const std::function<void(int)>& test)
+		{
+			Test = TestGenerator<void(int)>(test, "Instances", __FILE__, __LINE__)
+				.AddTestsFromIndexed([numInstances]() { return values::Range(0, numInstances); })
+				.Generate();
+			Test->Expand();
+
+			Test->Children[0]->Definition->Index = 0;
+			runner._history.Record(TestHistory::KeyOf(*Test->Children[0]), estimate * numInstances);
+		}
+
+		std::vector<TestContext> Contexts() { return { TestContext{ &Definition(), &Result } }; }
+
+		const TestDefinition& Definition() const { return *Test->Children[0]->Definition; }
+	};
+
+	// The error a test fails with when it's run right here, empty if it passes
+	inline std::string FailureOf(const TestObject& test)
+	{
+		try
+		{
+			std::invoke(test.Definition->_test);
+		}
+		catch (const test_failure& failure)
+		{
+			return failure.error();
+		}
+		return {};
+	}
+
+	// Busy waits like FrameworkConcurrency::WaitFor, so the test occupies a core
+	inline void Spin(std::chrono::microseconds duration)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		while (std::chrono::high_resolution_clock::now() - start < duration)
+		{}
+	}
+}
@@ -1,9 +1,24 @@
 
 #include "TestFramework/TestFramework.h"
+#include "SyntheticSuite.h"
+#include "TestFramework/TestForkServer.h"
+#include "TestFramework/AtomicBitset.h"
 #include <memory>
 #include <thread>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <atomic>
+#include <algorithm>
+#include <numeric>
+#include <array>
+#include <fstream>
+#include <sstream>
+
+#if defined __linux__
+#include <unistd.h>
+#endif
 
 using namespace lsn::test_framework;
 
@@ -105,6 +120,56 @@ DeclareTestCategory(Examples)
 		AssertThat(a < b);
 	}
 
+	// Arguments can also be enumerated lazily by index, as every combination of several sources
+	// Each source is one of ValueSource(function), Values(...) or Range(begin, end)
+	DeclareTest(CombinedArguments,
+		Combine(Range(0, 3), Values(10, 20)),
+		Arguments(int a, int b))
+	{
+		AssertThat(a < b);
+	}
+
+	// Or with the sources side by side, as many instances as the shortest source
+	DeclareTest(ZippedArguments,
+		Zip(ValueSource(Example::ValueSources::IntegerRange<1, 5>), Range(2, 100)),
+		Arguments(int a, int b))
+	{
+		AssertThat(a + 1 == b);
+	}
+
+	// Properties are checked against randomly generated arguments, from the generators in TestProperty.h
+	// Their trials are spread across the workers, and a failure is shrunk to the simplest arguments that still fail
+	DeclareProperty(ReversingTwiceIsIdentity,
+		ForAll(Vectors(Integers(-100, 100))),
+		Trials(500),
+		Arguments(std::vector<int> values))
+	{
+		auto reversed = values;
+		std::reverse(reversed.begin(), reversed.end());
+		std::reverse(reversed.begin(), reversed.end());
+		AssertThat(reversed == values);
+	}
+
+	// Benchmarks are timed over as many iterations as fit their target time, after a warmup.
+	// They're always exclusive, and their statistics are kept with their result
+	DeclareBenchmark(VectorPushBack, Warmup(5ms), TargetTime(20ms))
+	{
+		std::vector<int> values;
+		for (int i = 0; i < 64; ++i)
+			values.push_back(i);
+		// without these the compiler is free to drop the whole loop
+		DoNotOptimize(values.data());
+		ClobberMemory();
+	}
+
+	// Hot paths can be held to an allocation budget, enforced when built with ELISION_TRACK_ALLOCATIONS
+	DeclareTest(SumWithoutAllocating, MaxAllocations(0))
+	{
+		int values[64];
+		std::iota(std::begin(values), std::end(values), 0);
+		AssertThat(std::accumulate(std::begin(values), std::end(values), 0) == 2016);
+	}
+
 	// Additional test options are also availble
 	DeclareTest(Options,
 		/* Configurable concurrency requirements allow tests to be run
@@ -128,7 +193,10 @@ DeclareTestCategory(FrameworkConcurrency)
 	{
 		auto start = std::chrono::high_resolution_clock::now().time_since_epoch();
 		while (std::chrono::high_resolution_clock::now().time_since_epoch() - start < time)
-		{}
+		{
+			// stop as soon as we're timed out or cancelled, rather than waiting to be killed
+			CheckCancelled();
+		}
 	}
 
 	DeclareTest(ExclusiveWait, WithConcurrency(TestConcurrency::Exclusive),
@@ -161,4 +229,1589 @@ DeclareTestCategory(FrameworkConcurrency)
 	{
 		while (true) {}
 	}
-}
\ No newline at end of file
+}
+
+DeclareTestCategory(FrameworkIsolation)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+
+	TestExecutionOptions ProcessIsolation()
+	{
+		auto options = TestExecutionOptions().ForceOntoMainThread();
+		options.Isolation = TestIsolation::Process;
+		return options;
+	}
+
+	std::string Target(const std::string& name)
+	{
+		return "FrameworkIsolation/Targets/" + name;
+	}
+
+	int MutatedState = 0;
+
+	// What the tests below run in worker processes, which only ever run registered tests.
+	// Each only misbehaves in a worker, anywhere else they pass.
+	DeclareTestSubCategory(FrameworkIsolation, Targets)
+	{
+		DeclareTest(Crashes)
+		{
+			if (TestForkServer::IsWorker())
+				std::abort();
+		}
+
+		DeclareTest(Fails)
+		{
+			if (TestForkServer::IsWorker())
+				AssertThat(false);
+		}
+
+		DeclareTest(Passes)
+		{
+		}
+
+		DeclareTest(Hangs)
+		{
+			while (TestForkServer::IsWorker()) {}
+		}
+
+		DeclareTest(StartsPristine, Combine(Range(0, 4)), Arguments(int _))
+		{
+			if (TestForkServer::IsWorker())
+				AssertThat(++MutatedState == 1);
+		}
+
+		DeclareTest(Trivial, Combine(Range(0, 20)), Combine(Range(20, 41)), Combine(Range(41, 60)), Arguments(int _))
+		{
+		}
+
+		DeclareTest(FailsEveryThird, Combine(Range(0, 10)), Arguments(int i))
+		{
+			if (TestForkServer::IsWorker())
+				AssertThat(i % 3 != 0);
+		}
+
+		DeclareTest(HoldsDevice, WithConcurrency(TestConcurrency::Privileged), Uses("Device"))
+		{
+			std::this_thread::sleep_for(50ms);
+		}
+
+		DeclareTest(UsesDevice, Uses("Device"), Combine(Range(0, 4)), Arguments(int _))
+		{
+		}
+
+#if defined __linux__
+		int NumInitialized = 0;
+		pid_t InitializedIn = 0;
+
+		DeclareTestSubCategory(Targets, Initialized)
+		{
+			DeclareTestInitializer()
+			{
+				++NumInitialized;
+				InitializedIn = getpid();
+			}
+
+			// forked by the zygote, which ran the initializer before it forked
+			DeclareTest(SharesTheZygotesInitializer)
+			{
+				AssertThat(NumInitialized == 1);
+				if (TestForkServer::IsWorker())
+					AssertThat(InitializedIn != getpid());
+			}
+		}
+#endif
+	}
+
+	DeclareTest(CrashIsContained, Timeout(10s))
+	{
+		if (!TestProcessPool::IsSupported())
+			return;
+
+		RegisteredSuite suite;
+		for (auto name : { "Crashes", "Fails", "Passes" })
+			suite.Add(Target(name));
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, ProcessIsolation());
+
+		AssertThat(!suite.Results[0].HasPassed());
+		AssertThat(suite.Results[0].LastFailure()->error().starts_with("worker process crashed"));
+		AssertThat(!suite.Results[1].HasPassed() && suite.Results[1].LastFailure()->error() == "false");
+		AssertThat(suite.Results[2].HasRun() && suite.Results[2].HasPassed());
+
+		// only the crashed worker should have been replaced
+		AssertThat(runner._processPool.NumRespawned() == 1);
+	}
+
+	// a worker can only find a test that's registered
+	DeclareTest(UnregisteredTestsFail, Timeout(10s))
+	{
+		if (!TestProcessPool::IsSupported())
+			return;
+
+		SyntheticSuite suite(1, []() {});
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, ProcessIsolation());
+
+		AssertThat(!suite.Results[0].HasPassed());
+		AssertThat(suite.Results[0].LastFailure()->error().find("isn't a registered test") != std::string::npos);
+	}
+
+	// every test is forked from the same image, the one the program started with, so none of them should see what
+	// the others or this process did
+	DeclareTest(ZygoteStartsPristine, Timeout(10s))
+	{
+		if (!TestProcessPool::IsSupported())
+			return;
+
+		RegisteredSuite suite;
+		suite.Add(Target("StartsPristine"));
+		suite.Add(Target("Crashes"));
+
+		TestRunner runner;
+		auto options = ProcessIsolation();
+		options.Isolation = TestIsolation::Zygote;
+
+		MutatedState = 1;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+		MutatedState = 0;
+
+		// each of its instances is forked on its own
+		AssertThat(suite.Results[0].HasRun() && suite.Results[0].HasPassed());
+		AssertThat(suite.Results[1].LastFailure()->error().starts_with("worker process crashed"));
+
+		AssertThat(runner._processPool.NumForked() == 5);
+	}
+
+#if defined __linux__
+	// the zygote has already run the shared initializers, the tests it forks only inherit them
+	DeclareTest(ZygoteRunsInitializers, Timeout(10s))
+	{
+		if (!TestProcessPool::IsSupported())
+			return;
+
+		RegisteredSuite suite;
+		suite.Add(Target("Initialized/SharesTheZygotesInitializer"));
+
+		TestRunner runner;
+		auto options = ProcessIsolation();
+		options.Isolation = TestIsolation::Zygote;
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+
+		AssertThat(suite.AllPassed());
+	}
+#endif
+
+	DeclareTest(HungTestIsKilled, Timeout(10s))
+	{
+		if (!TestProcessPool::IsSupported())
+			return;
+
+		RegisteredSuite suite;
+		suite.Add(Target("Hangs"));
+		suite.Add(Target("Passes"));
+
+		TestRunner runner;
+		auto options = ProcessIsolation();
+		options.DefaultTimeOut = 50ms;
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+
+		AssertThat(!suite.Results[0].HasPassed());
+		AssertThat(suite.Results[0].LastFailure()->error().starts_with("exceeded timeout"));
+		AssertThat(suite.Results[1].HasRun() && suite.Results[1].HasPassed());
+		AssertThat(runner._processPool.NumRespawned() == 1);
+	}
+
+	// what became of each instance comes back from the worker along with the result
+	DeclareTest(InstanceResultsSurviveTheWorker, Timeout(10s))
+	{
+		if (!TestProcessPool::IsSupported())
+			return;
+
+		for (auto isolation : { TestIsolation::Process, TestIsolation::Zygote })
+		{
+			RegisteredSuite suite;
+			suite.Add(Target("FailsEveryThird"));
+
+			TestRunner runner;
+			auto options = ProcessIsolation();
+			options.Isolation = isolation;
+			auto contexts = suite.Contexts();
+			runner.Run(contexts, options);
+
+			auto recorded = suite.Results[0].Instances();
+			AssertThat(recorded && recorded->NumPassed() == 6 && recorded->NumFailed() == 4);
+			AssertThat(recorded->FailureOf(9) && recorded->OutcomeOf(8) == TestInstanceResults::Outcome::Passed);
+		}
+	}
+
+	// a crash or a hang only costs the test that caused it, the rest of that worker's lease is run elsewhere
+	DeclareTest(DistributedLeasesAreRequeued, Timeout(20s))
+	{
+		if (!TestDistributor::IsSupported())
+			return;
+
+		RegisteredSuite suite;
+		suite.Add(Target("Trivial"));
+		suite.Add(Target("Crashes"));
+		suite.Add(Target("Hangs"));
+		constexpr size_t Crashes = 3, Hangs = 4;
+
+		TestRunner runner;
+		TestExecutionOptions options;
+		options.Isolation = TestIsolation::Distributed;
+		options.MaxNumberOfSimultaneousThreads = 2;
+		options.DefaultTimeOut = 100ms;
+
+		// spread between the instances of each source, so each lands in the middle of a lease
+		auto contexts = suite.Contexts();
+		contexts = { contexts[0], contexts[Crashes], contexts[1], contexts[Hangs], contexts[2] };
+		runner.Run(contexts, options);
+		runner.Join();
+
+		for (size_t i = 0; i < suite.Results.size(); ++i)
+		{
+			if (i == Crashes || i == Hangs)
+				continue;
+			AssertThat(suite.Results[i].HasRun() && suite.Results[i].HasPassed());
+		}
+
+		AssertThat(suite.Results[Crashes].LastFailure()->error().starts_with("worker process crashed"));
+		AssertThat(suite.Results[Hangs].LastFailure()->error().starts_with("exceeded timeout"));
+		AssertThat(runner._distributor.NumLeases() > 2);
+		AssertThat(runner._distributor.NumRequeued() > 0);
+		AssertThat(runner._distributor.NumDismissed() > 0);
+	}
+
+	// a distributed test waiting on a privileged test's resource is leased once the resource is released
+	DeclareTest(DistributedTestsWaitForPrivilegedResources, Timeout(20s))
+	{
+		if (!TestDistributor::IsSupported())
+			return;
+
+		RegisteredSuite suite;
+		suite.Add(Target("HoldsDevice"));
+		suite.Add(Target("UsesDevice"));
+
+		TestRunner runner;
+		TestExecutionOptions options;
+		options.Isolation = TestIsolation::Distributed;
+		options.MaxNumberOfSimultaneousThreads = 2;
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+		runner.Join();
+
+		AssertThat(suite.AllPassed());
+	}
+}
+
+
+DeclareTestCategory(FrameworkScheduling)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+
+	DeclareTest(LongestTestsRunFirst)
+	{
+		std::vector<int> order;
+		SyntheticSuite suite;
+		for (int i = 0; i < 5; ++i)
+			suite.Add(1, [&order, i]() { order.push_back(i); });
+
+		// the last test has no history of its own, so it takes the mean of its siblings (25ms)
+		TestRunner runner;
+		for (auto [i, duration] : { std::pair{ 0, 10ms }, { 1, 40ms }, { 2, 20ms }, { 3, 30ms } })
+			runner._history.Record(TestHistory::KeyOf(*suite.Root.Children[i]), duration);
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		AssertThat(suite.AllPassed());
+		AssertThat(order == std::vector<int>({ 1, 3, 4, 2, 0 }));
+	}
+
+	// cheap instances of a parameterized test share a job, yet a failure still names the instance
+	DeclareTest(CheapInstancesAreBatched, Timeout(10s))
+	{
+		std::atomic<int> numRun = 0;
+		TestRunner runner;
+		SyntheticInstances instances(runner, 64, 10us, [&numRun](int i)
+		{
+			++numRun;
+			AssertThat(i != 7);
+		});
+
+		auto contexts = instances.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		AssertThat(numRun == 64);
+		AssertThat(runner.NumBatches() > 0 && runner.NumBatches() < 64);
+		AssertThat(instances.Result.HasRun() && instances.Result.LastFailure()->error().starts_with("Instances(7): "));
+
+		auto recorded = instances.Result.Instances();
+		AssertThat(recorded && recorded->NumPassed() == 63 && recorded->NumFailed() == 1);
+		AssertThat(recorded->OutcomeOf(7) == TestInstanceResults::Outcome::Failed && recorded->OutcomeOf(8) == TestInstanceResults::Outcome::Passed);
+	}
+
+	// every instance keeps its own outcome, not just the first to fail
+	DeclareTest(EveryInstanceIsRecorded, Timeout(10s))
+	{
+		TestRunner runner;
+		SyntheticInstances instances(runner, 1000, 10us, [](int i)
+		{
+			AssertThat(i % 25 != 0);
+		});
+
+		auto contexts = instances.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		auto recorded = instances.Result.Instances();
+		AssertThat(recorded && recorded->NumPassed() == 960 && recorded->NumFailed() == 40);
+
+		auto snapshot = recorded->Read();
+		AssertThat(snapshot.Failures.size() == 40 && snapshot.Failures[39].first == 975);
+		AssertThat(snapshot.Ran == std::vector<InstanceRange>({ { 0, 1000 } }));
+		AssertThat(recorded->FailureOf(50) && !recorded->FailureOf(51));
+	}
+
+	// an instance is only counted once, and only so many failures are kept however many there are
+	DeclareTest(InstanceResultsAreBounded)
+	{
+		TestInstanceResults instances;
+		test_failure failure("failed", __FILE__, __LINE__);
+		for (uint64_t i = TestInstanceResults::MaxRecorded * 2; i-- > 0; )
+			instances.Record(i, &failure);
+		instances.Record(3, nullptr);
+
+		AssertThat(instances.NumFailed() == TestInstanceResults::MaxRecorded * 2 && instances.NumPassed() == 0);
+		AssertThat(instances.Read().Failures.size() == TestInstanceResults::MaxRecorded);
+		AssertThat(instances.OutcomeOf(0) == TestInstanceResults::Outcome::Failed);
+		AssertThat(instances.OutcomeOf(TestInstanceResults::MaxRecorded * 2) == TestInstanceResults::Outcome::NotRun);
+	}
+
+	// an instance that hangs takes the batch's budget, and the instances after it are run in a job of their own
+	DeclareTest(HungInstanceDoesNotSinkBatch, Timeout(10s))
+	{
+		std::atomic<int> numRun = 0;
+		TestRunner runner;
+		SyntheticInstances instances(runner, 8, 10us, [&numRun](int i)
+		{
+			while (i == 2)
+				CheckCancelled();
+			++numRun;
+		});
+
+		auto options = TestExecutionOptions().ForceOntoMainThread();
+		options.DefaultTimeOut = 20ms;
+		auto contexts = instances.Contexts();
+		runner.Run(contexts, options);
+
+		AssertThat(runner.NumBatches() > 0);
+		AssertThat(instances.Result.LastFailure()->error().starts_with("Instances(2): exceeded timeout"));
+		AssertThat(numRun == 7);
+	}
+
+	// cancelling a range fails the instance it was on, and the ones it never reached are left unrun
+	DeclareTest(CancelledBatchLeavesTheRestUnrun, Timeout(10s))
+	{
+		std::atomic<int> lastRun = -1;
+		TestRunner runner;
+		SyntheticInstances instances(runner, 8, 10us, [&lastRun](int i)
+		{
+			lastRun = i;
+			while (i == 2)
+				CheckCancelled();
+		});
+
+		auto contexts = instances.Contexts();
+		runner.Run(contexts, TestExecutionOptions());
+		std::this_thread::sleep_for(20ms);
+		runner.Cancel();
+
+		AssertThat(runner.NumBatches() > 0);
+		AssertThat(instances.Result.LastFailure()->error() == "Instances(2): cancelled");
+		AssertThat(lastRun == 2 && runner.IsFinished(&instances.Definition()));
+	}
+
+	// a test that never waited on anything, yet only had a fraction of the cpu, was waiting on a core
+	DeclareTest(OversubscribedWorkersAreParked, WithConcurrency(TestConcurrency::Exclusive), Timeout(30s))
+	{
+		ResourceUsage starved{ 10ms, 2ms };
+		ResourceUsage computing{ 10ms, 10ms };
+		ResourceUsage waiting = starved;
+		waiting.VoluntarySwitches = 1;
+
+		OversubscriptionMonitor watching(3, 0.75, false);
+		for (int i = 0; i < 5; ++i)
+			watching.Record(starved);
+		AssertThat(watching.NumOversubscribed() == 1 && watching.ActiveWorkers() == 3);
+
+		OversubscriptionMonitor monitor(3, 0.75, true);
+		for (int i = 0; i < 10; ++i)
+			monitor.Record(waiting);
+		AssertThat(monitor.ActiveWorkers() == 3);
+
+		for (int i = 0; i < 5; ++i)
+			monitor.Record(starved);
+		AssertThat(monitor.ActiveWorkers() == 2);
+
+		for (int i = 0; i < 10; ++i)
+			monitor.Record(computing);
+		AssertThat(monitor.ActiveWorkers() == 2);
+
+		for (int i = 0; i < 50; ++i)
+			monitor.Record(starved);
+		AssertThat(monitor.ActiveWorkers() == 1);
+
+		if (!TestUsage::Start())
+			return;
+
+		// more workers spinning than there are cores to spin on
+		int numWorkers = 2 * (int)std::max(std::thread::hardware_concurrency(), 1u) + 1;
+		SyntheticSuite suite(numWorkers * 4, []() { Spin(10ms); });
+
+		TestExecutionOptions options;
+		options.MaxNumberOfSimultaneousThreads = numWorkers;
+		options.MinimumNumberOfTestsPerThread = 1;
+		options.ParkOversubscribedWorkers = true;
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+		runner.Join();
+
+		AssertThat(suite.AllPassed());
+		AssertThat(runner.NumOversubscriptions() > 0 && runner.NumParkedWorkers() > 0);
+	}
+
+	DeclareTest(HistoryIsPersisted)
+	{
+		auto file = std::filesystem::temp_directory_path() / "TestHistory_HistoryIsPersisted.txt";
+
+		TestHistory history;
+		history.Record("Category/Test With Spaces(1, 2)", 30ms);
+		history.Record("Category/Test With Spaces(1, 2)", 70ms);
+		history.Record("Category/Other", 5ms);
+		AssertThat(history.Save(file));
+
+		TestHistory loaded;
+		AssertThat(loaded.Load(file));
+		std::filesystem::remove(file);
+
+		AssertThat(loaded.Size() == 2);
+		AssertThat(loaded.Find("Category/Test With Spaces(1, 2)") == history.Find("Category/Test With Spaces(1, 2)"));
+		AssertThat(loaded.Find("Category/Other") == std::chrono::nanoseconds(5ms));
+		AssertThat(!loaded.Find("Category/Missing"));
+	}
+
+	// Tracks how many tests are inside at once
+	struct Occupancy
+	{
+		std::atomic<int> Current = 0;
+		std::atomic<int> Peak = 0;
+
+		void Visit(std::chrono::milliseconds duration)
+		{
+			int current = ++Current;
+			int peak = Peak;
+			while (current > peak && !Peak.compare_exchange_weak(peak, current))
+			{}
+
+			std::this_thread::sleep_for(duration);
+			--Current;
+		}
+	};
+
+	DeclareTest(ResourcesAreNotShared, Timeout(10s))
+	{
+		Occupancy database, cpu;
+
+		SyntheticSuite suite;
+		suite.Add(8, [&]() { database.Visit(2ms); }, TestConcurrency::Any, { { "db", 1 } });
+		suite.Add(8, [&]() { cpu.Visit(2ms); }, TestConcurrency::Any, { { "cpu-heavy", 2 } });
+		suite.Add(8, []() { std::this_thread::sleep_for(2ms); });
+
+		TestRunner runner;
+		TestExecutionOptions options;
+		options.MaxNumberOfSimultaneousThreads = 4;
+		options.MinimumNumberOfTestsPerThread = 1;
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+		runner.Join();
+
+		AssertThat(suite.AllPassed());
+		AssertThat(database.Peak == 1);
+		AssertThat(cpu.Peak <= 2);
+	}
+
+	// a privileged test still respects the resources held by the pool
+	DeclareTest(PrivilegedTestsWaitForResources, Timeout(10s))
+	{
+		Occupancy database;
+
+		SyntheticSuite suite;
+		suite.Add(4, [&]() { database.Visit(2ms); }, TestConcurrency::Privileged, { { "db", 1 } });
+		suite.Add(8, [&]() { database.Visit(2ms); }, TestConcurrency::Any, { { "db", 1 } });
+
+		TestRunner runner;
+		TestExecutionOptions options;
+		options.MaxNumberOfSimultaneousThreads = 4;
+		options.MinimumNumberOfTestsPerThread = 1;
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+		runner.Join();
+
+		AssertThat(suite.AllPassed());
+		AssertThat(database.Peak == 1);
+	}
+
+	// naming a resource twice still only takes it once, at the narrower capacity
+	DeclareTest(DeclaresResources, Uses("FrameworkScheduling", 1), Uses("cpu-heavy", 2), Uses("cpu-heavy", 3))
+	{
+		const auto* definition = CurrentTest()->Definition;
+		AssertThat(definition->_parent->Name == "DeclaresResources");
+		AssertThat(definition->Resources == std::vector<TestResource>({ { "FrameworkScheduling", 1 }, { "cpu-heavy", 2 } }));
+	}
+
+	// a test abandoned while still running keeps its resources, whoever needs them next fails instead of sharing them
+	DeclareTest(AbandonedTestsKeepTheirResources, Timeout(10s))
+	{
+		auto release = std::make_shared<std::atomic<bool>>(false);
+		SyntheticSuite suite;
+		suite.Add(1, [release]()
+		{
+			while (!*release)
+				std::this_thread::yield();
+		}, TestConcurrency::Any, { { "Device" } });
+		suite.Add(1, []() {}, TestConcurrency::Any, { { "Device" } });
+
+		TestRunner runner;
+		auto options = TestExecutionOptions().ForceOntoMainThread();
+		options.DefaultTimeOut = 20ms;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, options);
+
+		AssertThat(suite.Results[0].LastFailure()->error().starts_with("exceeded timeout"));
+		AssertThat(suite.Results[1].LastFailure()->error() == "needs Device, which is still held by a test that was abandoned");
+
+		// the abandoned test is still running the suite's definition, it has to be done with it first
+		*release = true;
+		std::this_thread::sleep_for(20ms);
+	}
+
+	// every test lands in exactly one shard, in the same one every time whatever each machine's own history says,
+	// and given shared durations the shards are balanced by them
+	DeclareTest(ShardsAreStableAndBalanced)
+	{
+		constexpr int NumShards = 3;
+
+		SyntheticSuite suite(40, []() {});
+		TestHistory history;
+		for (size_t i = 0; i < suite.Root.Children.size(); ++i)
+			history.Record(TestHistory::KeyOf(*suite.Root.Children[i]), std::chrono::milliseconds(i % 7 == 0 ? 100 : 1 + i));
+
+		auto file = std::filesystem::temp_directory_path() / "TestHistory_ShardsAreStableAndBalanced.txt";
+		AssertThat(history.Save(file));
+
+		auto contexts = suite.Contexts();
+		history.Estimate(contexts);
+
+		// another machine ran the tests in a different order and has seen different durations
+		auto elsewhere = contexts;
+		std::reverse(elsewhere.begin(), elsewhere.end());
+		for (size_t i = 0; i < elsewhere.size(); ++i)
+			elsewhere[i].EstimatedDuration = std::chrono::milliseconds(i * 3);
+
+		for (bool shared : { false, true })
+		{
+			std::vector<int> owners(contexts.size(), -1);
+			std::vector<std::chrono::nanoseconds> loads;
+			for (int index = 0; index < NumShards; ++index)
+			{
+				TestShard shard{ index, NumShards, shared ? file : std::filesystem::path() };
+				auto selected = shard.Select(contexts);
+				auto fromElsewhere = shard.Select(elsewhere);
+				AssertThat(selected.size() == fromElsewhere.size());
+
+				std::chrono::nanoseconds load{ 0 };
+				for (const auto& context : selected)
+				{
+					auto i = context.Result - suite.Results.data();
+					AssertThat(owners[i] == -1);
+					owners[i] = index;
+					load += context.EstimatedDuration;
+				}
+
+				for (const auto& context : fromElsewhere)
+					AssertThat(owners[context.Result - suite.Results.data()] == index);
+
+				loads.push_back(load);
+			}
+
+			AssertThat(std::find(owners.begin(), owners.end(), -1) == owners.end());
+
+			// greedy longest first is within one test of perfectly even
+			auto [lightest, heaviest] = std::minmax_element(loads.begin(), loads.end());
+			if (shared)
+				AssertThat(*heaviest - *lightest <= 100ms);
+		}
+
+		std::filesystem::remove(file);
+	}
+
+	// every shard runs a contiguous slice of a test's instances rather than the whole test landing on one
+	DeclareTest(InstancesAreShardedByRange)
+	{
+		TestRunner runner;
+		SyntheticInstances instances(runner, 10, 1ms, [](int) {});
+
+		std::vector<InstanceRange> slices;
+		for (int index = 0; index < 4; ++index)
+		{
+			for (const auto& context : TestShard{ index, 4 }.Select(instances.Contexts()))
+				slices.push_back(context.Instances);
+		}
+
+		AssertThat(slices == std::vector<InstanceRange>({ { 0, 3 }, { 3, 6 }, { 6, 8 }, { 8, 10 } }));
+	}
+
+	// given durations, instances go to whichever shards the whole tests left lightest
+	DeclareTest(InstanceSlicesAreWeighedByCost)
+	{
+		TestRunner runner;
+		SyntheticSuite suite(2, []() {});
+		SyntheticInstances instances(runner, 10, 1ms, [](int) {});
+
+		TestHistory history;
+		for (const auto& test : suite.Root.Children)
+			history.Record(TestHistory::KeyOf(*test), 100ms);
+		history.Record(TestHistory::KeyOf(*instances.Test->Children[0]), 150ms);
+
+		auto file = std::filesystem::temp_directory_path() / "TestHistory_InstanceSlicesAreWeighedByCost.txt";
+		AssertThat(history.Save(file));
+
+		auto contexts = suite.Contexts();
+		auto parameterized = instances.Contexts();
+		contexts.insert(contexts.end(), parameterized.begin(), parameterized.end());
+
+		// the two whole tests take the first two shards, which leaves the third most of the instances
+		std::vector<InstanceRange> slices;
+		for (int index = 0; index < 3; ++index)
+		{
+			InstanceRange slice;
+			for (const auto& context : TestShard{ index, 3, file }.Select(contexts))
+			{
+				if (context.Definition == &instances.Definition())
+					slice = context.Instances;
+			}
+			slices.push_back(slice);
+		}
+
+		AssertThat(slices == std::vector<InstanceRange>({ { 0, 1 }, { 1, 2 }, { 2, 10 } }));
+		std::filesystem::remove(file);
+	}
+}
+
+
+DeclareTestCategory(FrameworkCancellation)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+
+	DeclareTest(CurrentTestIsVisible)
+	{
+		const TestDefinition* seen = nullptr;
+		SyntheticSuite suite(1, [&]() { seen = CurrentTest()->Definition; });
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		AssertThat(suite.AllPassed());
+		AssertThat(seen == suite.Root.Children[0]->Definition.get());
+	}
+
+	// a test that checks for cancellation stops at its timeout, instead of its worker being abandoned
+	DeclareTest(TimeoutStopsCooperativeTest, Timeout(10s))
+	{
+		std::atomic<bool> unwound = false;
+		SyntheticSuite suite(1, [&]()
+		{
+			struct OnUnwind { std::atomic<bool>& Flag; ~OnUnwind() { Flag = true; } } onUnwind{ unwound };
+			while (true)
+				CheckCancelled();
+		});
+
+		TestRunner runner;
+		auto options = TestExecutionOptions().ForceOntoMainThread();
+		options.DefaultTimeOut = 20ms;
+
+		auto contexts = suite.Contexts();
+		auto start = std::chrono::steady_clock::now();
+		runner.Run(contexts, options);
+
+		AssertThat(unwound);
+		AssertThat(std::chrono::steady_clock::now() - start < 2s);
+		AssertThat(suite.Results[0].LastFailure()->error().starts_with("exceeded timeout"));
+	}
+
+	DeclareTest(CancelWakesSleepingTest, Timeout(10s))
+	{
+		SyntheticSuite suite(1, []() { SleepFor(10s); });
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions());
+
+		std::this_thread::sleep_for(20ms);
+		auto start = std::chrono::steady_clock::now();
+		runner.Cancel();
+
+		AssertThat(std::chrono::steady_clock::now() - start < 1s);
+		AssertThat(suite.Results[0].LastFailure()->error() == "cancelled");
+	}
+
+	// a test that never checks is abandoned once the grace period is up, and can't touch its result from then on
+	DeclareTest(CancelAbandonsHungTest, Timeout(10s))
+	{
+		auto release = std::make_shared<std::atomic<bool>>(false);
+		SyntheticSuite suite(1, [release]()
+		{
+			while (!*release)
+				std::this_thread::yield();
+		});
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions());
+
+		std::this_thread::sleep_for(20ms);
+		auto start = std::chrono::steady_clock::now();
+		runner.Cancel();
+		AssertThat(std::chrono::steady_clock::now() - start < 2s);
+
+		*release = true;
+		std::this_thread::sleep_for(20ms);
+		AssertThat(suite.Results[0].LastFailure()->error() == "cancelled");
+	}
+
+	// a runner that goes away mid session cancels it rather than take the process down with it
+	DeclareTest(DestroyingRunnerCancelsSession, Timeout(10s))
+	{
+		SyntheticSuite suite(1, []()
+		{
+			while (true)
+				CheckCancelled();
+		});
+
+		{
+			TestRunner runner;
+			auto contexts = suite.Contexts();
+			runner.Run(contexts, TestExecutionOptions());
+			std::this_thread::sleep_for(20ms);
+		}
+
+		AssertThat(suite.Results[0].LastFailure()->error() == "cancelled");
+	}
+}
+
+
+DeclareTestCategory(FrameworkResults)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+
+	// every registered test has a result of its own
+	DeclareTest(ResultsAreIndexedDensely)
+	{
+		auto& manager = TestManager::Instance();
+
+		std::unordered_set<const TestResult*> results;
+		size_t numTests = 0;
+		for (const auto& category : manager.Categories())
+		{
+			category.VisitAllTests([&](const TestDefinition* test)
+			{
+				++numTests;
+				results.insert(manager.FetchResult(test));
+				AssertThat(manager.FetchResult(test->_parent) == manager.FetchResult(test));
+			});
+
+			AssertThat(manager.FetchResult(&category) == nullptr);
+		}
+
+		AssertThat(!results.contains(nullptr));
+		AssertThat(results.size() == numTests);
+	}
+
+	// a reader racing a writer only ever sees whole results
+	DeclareTest(SnapshotsAreConsistent, Timeout(10s))
+	{
+		TestResult result;
+		std::atomic<bool> done = false;
+
+		std::thread writer([&]()
+		{
+			for (int64_t start = 1; start < 200000; ++start)
+			{
+				result.Reset();
+				result.Begin(std::chrono::nanoseconds(start));
+				if (start % 2)
+					result.SetFailure(test_failure(std::to_string(start), __FILE__, __LINE__));
+				result.End(std::chrono::nanoseconds(start + 5));
+			}
+			done = true;
+		});
+
+		size_t numFinished = 0;
+		while (!done)
+		{
+			const TestResult snapshot = result;
+			if (!snapshot.HasRun())
+				continue;
+
+			++numFinished;
+			auto start = snapshot.TimeStarted().count();
+			AssertThat(snapshot.TimeTaken() == 5ns);
+			AssertThat(snapshot.HasPassed() == (start % 2 == 0));
+			if (!snapshot.HasPassed())
+				AssertThat(snapshot.LastFailure()->error() == std::to_string(start));
+		}
+
+		writer.join();
+	}
+
+	// ranges that ran alongside each other take the wall time between them, while their cost is what they all took
+	DeclareTest(GatheredRangesKeepWallTime)
+	{
+		auto part = [](int64_t started, int64_t ended)
+		{
+			TestResult result;
+			result.Begin(std::chrono::nanoseconds(started));
+			result.End(std::chrono::nanoseconds(ended));
+			return result;
+		};
+
+		TestResult gathered;
+		gathered.Gather(part(20, 30));
+		gathered.Gather(part(10, 25));
+		gathered.Gather(TestResult()); // stranded before it ran
+		gathered.Gather(part(15, 40));
+
+		AssertThat(gathered.TimeStarted() == 10ns);
+		AssertThat(gathered.TimeEnded() == 40ns);
+		AssertThat(gathered.TimeTaken() == 30ns);
+		AssertThat(gathered.Cost() == 50ns);
+		AssertThat(part(20, 30).Cost() == 10ns);
+
+		const TestResult copy = gathered;
+		AssertThat(copy.Cost() == 50ns);
+	}
+
+	// the runner's bits follow each test from scheduled through running to finished
+	DeclareTest(RunStateIsTracked, Timeout(10s))
+	{
+		TestRunner runner;
+		SyntheticSuite suite;
+		std::vector<bool> observed;
+
+		// exclusive tests with no history run one after the other in registration order
+		suite.Add(1, []() {}, TestConcurrency::Exclusive);
+		suite.Add(1, [&]()
+		{
+			const auto* first = suite.Root.Children[0]->Definition.get();
+			const auto* second = suite.Root.Children[1]->Definition.get();
+			observed = { runner.IsScheduled(first), runner.IsRunning(first), runner.IsFinished(first),
+				runner.IsScheduled(second), runner.IsRunning(second), runner.IsFinished(second) };
+		}, TestConcurrency::Exclusive);
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		AssertThat(suite.AllPassed());
+		const std::vector<bool> expected{ true, false, true, true, true, false };
+		AssertThat(observed == expected);
+
+		for (const auto& test : suite.Root.Children)
+		{
+			AssertThat(!runner.IsScheduled(test->Definition.get()));
+			AssertThat(!runner.IsRunning(test->Definition.get()));
+			AssertThat(runner.IsFinished(test->Definition.get()));
+		}
+	}
+
+	// a category's counts follow its tests through the session without being recounted
+	DeclareTest(CategoryCountsFollowTests, Timeout(10s))
+	{
+		TestRunner runner;
+		SyntheticSuite suite(3, []() {});
+		suite.Add(1, []() { throw std::runtime_error("expected"); });
+
+		uint32_t running = 0;
+		suite.Add(1, [&]() { running = suite.Root.Counts[TestResultStatus::Running]; }, TestConcurrency::Exclusive);
+
+		AssertThat(suite.Root.Counts[TestResultStatus::NotRun] == 5);
+		AssertThat(suite.Root.Status() == TestResultStatus::NotRun);
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		AssertThat(running == 1);
+		AssertThat(suite.Root.Counts[TestResultStatus::Passed] == 4);
+		AssertThat(suite.Root.Counts[TestResultStatus::Failed] == 1);
+		AssertThat(suite.Root.Counts.Total() == 5);
+		AssertThat(suite.Root.Status() == TestResultStatus::Failed);
+		AssertThat(suite.Root.Children[0]->Status() == TestResultStatus::Passed);
+	}
+
+	// files stay in the order they were linked, as they did when tests registered themselves on startup, and the
+	// records of each are put back into the order they were declared
+	DeclareTest(TreeKeepsDeclarationOrder)
+	{
+		static constexpr TestCategoryRegistration later{ "Later", nullptr, "b.cpp", 20 }, earlier{ "Earlier", nullptr, "b.cpp", 10 }, other{ "Other", nullptr, "a.cpp", 5 };
+		const TestCategoryRegistration* categories[] = { &later, &earlier, nullptr, &other };
+
+		std::deque<TestObject> roots;
+		BuildTestTree(categories, {}, roots);
+
+		AssertThat(roots.size() == 3);
+		AssertThat(roots[0].Name == "Earlier" && roots[1].Name == "Later" && roots[2].Name == "Other");
+	}
+
+	// each subtree is the run of nodes that follows it
+	DeclareTest(RegistryIsPreOrder)
+	{
+		TestObject root("Root");
+		auto* group = root.Add(std::make_unique<TestObject>("Group"));
+		group->Add(std::make_unique<TestObject>("First", std::make_unique<TestDefinition>([]() {})));
+		group->Add(std::make_unique<TestObject>("Second", std::make_unique<TestDefinition>([]() {})));
+		root.Add(std::make_unique<TestObject>("Last", std::make_unique<TestDefinition>([]() {})));
+
+		TestRegistry registry;
+		registry.Add(root);
+
+		AssertThat(registry.Size() == 5);
+		AssertThat(registry.NumTests() == 3);
+		AssertThat(group->Node == 1);
+
+		const std::vector<std::string_view> names{ "Root", "Group", "First", "Second", "Last" };
+		const std::vector<uint32_t> parents{ TestRegistry::NoParent, 0, 1, 1, 0 };
+		const std::vector<uint32_t> ends{ 5, 4, 3, 4, 5 };
+		for (uint32_t node = 0; node < registry.Size(); ++node)
+		{
+			AssertThat(registry.Name(node) == names[node]);
+			AssertThat(registry.Parent(node) == parents[node]);
+			AssertThat(registry.SubtreeEnd(node) == ends[node]);
+		}
+
+		std::vector<const TestDefinition*> visited;
+		registry.ForEachTestIn(group->Node, [&](const TestDefinition* test) { visited.push_back(test); });
+		const std::vector<const TestDefinition*> expected{ group->Children[0]->Definition.get(), group->Children[1]->Definition.get() };
+		AssertThat(visited == expected);
+	}
+
+	DeclareTest(QueryFiltersByNameAndStatus)
+	{
+		auto& manager = TestManager::Instance();
+		const auto* self = CurrentTest()->Definition->_parent;
+
+		TestQuery query;
+		query.StrMatch = "QueryFiltersByNameAndStatus";
+		auto results = manager.Query(query);
+		AssertThat(results.size() == 1 && results.contains(self));
+
+		query.StatusMask.reset(static_cast<size_t>(TestResultStatus::Running));
+		AssertThat(manager.Query(query).empty());
+	}
+}
+
+DeclareTestCategory(FrameworkParameters)
+{
+	using namespace FrameworkTests::Helpers;
+
+	// the value sources aren't run, and no instances exist, until the test is expanded
+	DeclareTest(InstancesAreCreatedOnDemand)
+	{
+		int numCalls = 0;
+		auto test = TestGenerator<void(int)>([](int) {}, "Lazy", __FILE__, __LINE__)
+			.AddTestsFromValues(0)
+			.AddTestsFromSource([&numCalls]() { ++numCalls; return std::vector<int>{ 1, 2, 3 }; })
+			.Generate();
+
+		AssertThat(numCalls == 0);
+		AssertThat(test->IsPending() && test->Children.empty());
+		AssertThat(test->Counts[TestResultStatus::NotRun] == 1);
+
+		// a test per source, a source of one value being named after it
+		AssertThat(test->Expand());
+		AssertThat(numCalls == 1);
+		AssertThat(!test->IsPending() && test->Children.size() == 2);
+		AssertThat(test->Children[0]->Name == "Lazy(0)" && test->Children[1]->Name == "Lazy[1..3]");
+		AssertThat(test->Children[1]->Definition->NumInstances == 3);
+		AssertThat(test->Counts[TestResultStatus::NotRun] == 2);
+
+		AssertThat(!test->Expand());
+		AssertThat(numCalls == 1);
+	}
+
+	// combinations are worked out from their index, so even enormous ones cost nothing to enumerate
+	DeclareTest(SourcesAreIndexed)
+	{
+		using namespace lsn::test_framework::values;
+
+		auto product = Combine(Range(0, 3), Values(10, 20));
+		AssertThat(product.size() == 6);
+		AssertThat(product[0] == std::tuple(0, 10));
+		AssertThat(product[1] == std::tuple(0, 20));
+		AssertThat(product[5] == std::tuple(2, 20));
+
+		auto zipped = Zip(Range(0, 3), Values(5, 6));
+		AssertThat(zipped.size() == 2);
+		AssertThat(zipped[1] == std::tuple(1, 6));
+
+		auto huge = Combine(Range(0, 100000), Range(0, 100000), Values('a', 'b'));
+		AssertThat(huge.size() == 20000000000ull);
+		AssertThat(huge[huge.size() - 1] == std::tuple(99999, 99999, 'b'));
+
+		// ranges span negative numbers and the whole of their type without overflowing
+		auto stepped = Range(-10, 10, 3);
+		AssertThat(stepped.size() == 7);
+		AssertThat(stepped[6] == std::tuple(8));
+		AssertThat(Range(5, 0).size() == 0);
+
+		auto whole = Range(std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+		AssertThat(whole.size() == 0xffffffffull);
+		AssertThat(whole[whole.size() - 1] == std::tuple(std::numeric_limits<int32_t>::max() - 1));
+		AssertThat(Range(0, 10, 0).size() == 0 && Range(0, 10, -1).size() == 0);
+
+		// too many combinations to count fails the source, rather than wrapping around to a handful of them
+		auto uncountable = Combine(Range<int64_t>(0, 1ll << 40), Range<int64_t>(0, 1ll << 40));
+		bool overflowed = false;
+		try { (void)uncountable.size(); } catch (const std::overflow_error&) { overflowed = true; }
+		AssertThat(overflowed);
+
+		auto test = TestGenerator<void(int64_t, int64_t)>([](int64_t, int64_t) {}, "Uncountable", __FILE__, __LINE__)
+			.AddTestsFromIndexed([]() { return Combine(Range<int64_t>(0, 1ll << 40), Range<int64_t>(0, 1ll << 40)); })
+			.Generate();
+		test->Expand();
+		AssertThat(test->Children.size() == 1 && test->Children[0]->Name == "Uncountable[source 0]");
+		AssertThat(FailureOf(*test->Children[0]) == "too many combinations to count");
+	}
+
+	// running a category expands it, and each new instance gets a result of its own. A manager of our own, as
+	// only the thread that created one can expand its tests.
+	DeclareTest(ExpandedTestsHaveResults)
+	{
+		TestManager manager;
+		for (const auto& category : manager.Categories())
+		{
+			if (category.Name != "Examples")
+				continue;
+
+			manager.Expand(category);
+			category.VisitAllTests([&](const TestObject* test)
+			{
+				AssertThat(!test->IsPending());
+				if (test->Definition)
+					AssertThat(manager.FetchResult(test) != nullptr);
+			});
+		}
+	}
+}
+
+DeclareTestCategory(FrameworkProperties)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+
+	// shrinking borrows from helpers shared by every test, never more of them than there are free
+	DeclareTest(HelpersAreBounded, WithConcurrency(TestConcurrency::Exclusive), Timeout(10s))
+	{
+		std::atomic<bool> released = false;
+		std::atomic<size_t> numRunning = 0;
+		auto helpers = TestHelpers::Borrow(TestHelpers::Capacity() * 2, [&]()
+		{
+			++numRunning;
+			while (!released)
+				std::this_thread::yield();
+		});
+
+		AssertThat(helpers.size() == TestHelpers::Capacity());
+		AssertThat(TestHelpers::Borrow(1, []() {}).empty());
+
+		released = true;
+		TestHelpers::Wait(helpers);
+		AssertThat(numRunning == helpers.size());
+	}
+
+	// a counterexample is shrunk to the simplest arguments that still fail, the same ones on every run
+	DeclareTest(ShrinksToSimplestCounterexample)
+	{
+		auto test = TestGenerator<void(int, std::vector<int>)>([](int a, std::vector<int> values)
+		{
+			AssertThat(a < 100 || values.size() < 2);
+		}, "Shrinks", __FILE__, __LINE__)
+			.AddTestsFromProperty([]() { using namespace properties; return ForAll(Integers(0, 1000), Vectors(Integers(-50, 50), 8)); })
+			.SetTrials(100)
+			.Generate();
+		test->Expand();
+
+		AssertThat(test->Children.size() == 1);
+		auto failure = FailureOf(*test->Children[0]);
+		AssertThat(failure.starts_with("a < 100 || values.size() < 2 falsified by (100, [0, 0])"));
+		AssertThat(FailureOf(*test->Children[0]) == failure);
+	}
+
+	// shrinking stops once the arguments have nothing simpler left, rather than looking for one
+	DeclareTest(ShrinkingStopsAtTheTarget)
+	{
+		auto test = TestGenerator<void(bool, int)>([](bool, int)
+		{
+			AssertThat(false);
+		}, "AlwaysFails", __FILE__, __LINE__)
+			.AddTestsFromProperty([]() { using namespace properties; return ForAll(Booleans(), Integers(0, 1000)); })
+			.SetTrials(10)
+			.Generate();
+		test->Expand();
+
+		AssertThat(test->Children.size() == 1);
+		AssertThat(FailureOf(*test->Children[0]).starts_with("false falsified by (0, 0)"));
+	}
+
+	// the trials are split between instances, so the pool runs them in parallel
+	DeclareTest(TrialsAreSharedBetweenInstances)
+	{
+		std::atomic<size_t> numTrials = 0;
+		auto test = TestGenerator<void(bool)>([&numTrials](bool) { ++numTrials; }, "Shared", __FILE__, __LINE__)
+			.AddTestsFromProperty([]() { using namespace properties; return ForAll(Booleans()); })
+			.SetTrials(250)
+			.Generate();
+		test->Expand();
+
+		AssertThat(test->Children.size() == 1);
+		AssertThat(test->Children[0]->Name == "Shared[250 trials]" && test->Children[0]->Definition->NumInstances == 3);
+		AssertThat(FailureOf(*test->Children[0]).empty());
+		AssertThat(numTrials == 250);
+	}
+}
+
+DeclareTestCategory(FrameworkFuzzing)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+
+	FuzzOptions TemporaryOptions(const std::string& name)
+	{
+		FuzzOptions options;
+		options.FindingsFile = std::filesystem::temp_directory_path() / std::format("FuzzFindings_{}.txt", name);
+		options.MaxDuration = 5s;
+		std::filesystem::remove(options.FindingsFile);
+		std::filesystem::remove(options.FindingsFile.string() + ".crash");
+		return options;
+	}
+
+	// of the threads racing to set a bit only one finds it clear, so every new edge is counted once
+	DeclareTest(EdgesAreClaimedOnce, Timeout(10s))
+	{
+		constexpr size_t NumBits = 4096;
+		AtomicBitset bits;
+		bits.Reserve(NumBits);
+
+		std::atomic<size_t> numClaimed = 0;
+		{
+			std::vector<std::jthread> threads;
+			for (int i = 0; i < 4; ++i)
+			{
+				threads.emplace_back([&]()
+				{
+					for (size_t bit = 0; bit < NumBits; ++bit)
+						numClaimed += !bits.TestAndSet(bit);
+				});
+			}
+		}
+
+		AssertThat(numClaimed == NumBits && bits.Test(NumBits - 1));
+	}
+
+	DeclareTest(ArgumentsAreDecodedFromBytes)
+	{
+		const std::vector<uint8_t> bytes{ 0x01, 0x2a, 0x00, 0x00, 0x00, 0x03, 'a', '"', 'c', 0x02, 0x05 };
+		fuzzing::FuzzInput input(bytes);
+		AssertThat(input.Consume<bool>());
+		AssertThat(input.Consume<int>() == 42);
+		AssertThat(input.Consume<std::string>() == "a\"c");
+
+		// the input runs out part way through the vector, after that everything is zero
+		const std::vector<uint8_t> truncated{ 5 };
+		AssertThat(input.Consume<std::vector<uint8_t>>() == truncated);
+		AssertThat(input.Consume<int>() == 0 && input.Remaining() == 0);
+
+		const std::vector<std::string> strings{ "x", std::string("\0", 1) };
+		AssertThat(fuzzing::Literal(std::string("a\"c\n")) == R"("a\"c\012")");
+		AssertThat(fuzzing::Literal(strings) == R"({"x", std::string("\000", 1)})");
+		AssertThat(fuzzing::Literal(std::numeric_limits<int>::min()) == "(-2147483647 - 1)");
+		AssertThat(fuzzing::Literal(uint8_t(200)) == "200ull");
+	}
+
+	// the first failure is saved as a ValueCase that reproduces it
+	DeclareTest(FailuresBecomeValueCases, Timeout(10s))
+	{
+		AssertThat(TestGenerator<void()>([]() {}, "NoArguments", __FILE__, __LINE__).Generate()->Fuzz == nullptr);
+
+		auto test = TestGenerator<void(int, std::string)>([](int, std::string text)
+		{
+			AssertThat(!(text.size() >= 2 && text[0] == 'F'));
+		}, "Fuzzed", __FILE__, __LINE__)
+			.AddTestsFromValues(0, "")
+			.Generate();
+		AssertThat(test->Fuzz != nullptr);
+
+		auto options = TemporaryOptions("FailuresBecomeValueCases");
+		options.NumThreads = 1;
+		auto report = TestFuzzer::Fuzz(*test, options);
+
+		AssertThat(report.Finding.has_value());
+		AssertThat(report.Finding->ValueCase.starts_with("ValueCase("));
+		AssertThat(report.Finding->Error.starts_with("!(text.size() >= 2 && text[0] == 'F')"));
+
+		bool reproduced = false;
+		try
+		{
+			test->Fuzz->Run(report.Finding->Input);
+		}
+		catch (const test_failure&)
+		{
+			reproduced = true;
+		}
+		AssertThat(reproduced);
+
+		std::stringstream findings;
+		findings << std::ifstream(options.FindingsFile).rdbuf();
+		AssertThat(findings.str().find(report.Finding->ValueCase) != std::string::npos);
+		std::filesystem::remove(options.FindingsFile);
+	}
+
+	std::unique_ptr<TestObject> CrashingTest()
+	{
+		return TestGenerator<void(uint8_t)>([](uint8_t value)
+		{
+			if (value == 7)
+				std::abort();
+		}, "Crashes", __FILE__, __LINE__)
+			.AddTestsFromValues(0)
+			.Generate();
+	}
+
+	FuzzOptions CrashingOptions()
+	{
+		auto options = TemporaryOptions("CrashesAreRecovered");
+		options.NumThreads = 1;
+		return options;
+	}
+
+	// Run in a worker process by the tests below, anywhere else they pass
+	DeclareTestSubCategory(FrameworkFuzzing, Targets)
+	{
+		DeclareTest(FuzzesCrash)
+		{
+			if (TestForkServer::IsWorker())
+				TestFuzzer::Fuzz(*CrashingTest(), CrashingOptions());
+		}
+	}
+
+	// a crash takes the process down, the input it left behind is picked up by the next session
+	DeclareTest(CrashesAreRecovered, Timeout(20s))
+	{
+		if (!TestProcessPool::IsSupported() || !TestFuzzer::CanRecordCrashes())
+			return;
+
+		auto test = CrashingTest();
+		auto options = CrashingOptions();
+
+		RegisteredSuite suite;
+		suite.Add("FrameworkFuzzing/Targets/FuzzesCrash");
+		auto isolation = TestExecutionOptions().ForceOntoMainThread();
+		isolation.Isolation = TestIsolation::Process;
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, isolation);
+		AssertThat(suite.Results[0].LastFailure()->error().starts_with("worker process crashed"));
+
+		auto report = TestFuzzer::Fuzz(*test, options);
+		AssertThat(report.Finding.has_value());
+		AssertThat(report.Finding->ValueCase == "ValueCase(7ull)");
+		AssertThat(report.Finding->Error.starts_with("crashed with signal"));
+		AssertThat(!std::filesystem::exists(options.FindingsFile.string() + ".crash"));
+		std::filesystem::remove(options.FindingsFile);
+	}
+}
+
+DeclareTestCategory(FrameworkMeasurement)
+{
+	using namespace std::chrono_literals;
+	using namespace FrameworkTests::Helpers;
+
+	DeclareTest(StatisticsAreSummarized)
+	{
+		const std::vector<double> samples{ 10, 1, 9, 2, 8, 3, 7, 4, 6, 5 };
+		auto statistics = TestBenchmark::Summarize(samples, 100);
+
+		AssertThat(statistics.Samples == 10 && statistics.Iterations == 100);
+		AssertThat(statistics.Mean.count() == 5.5 && statistics.Median.count() == 5.5);
+		AssertThat(statistics.Min.count() == 1 && statistics.Max.count() == 10);
+		AssertThat(std::abs(statistics.P90.count() - 9.1) < 1e-9);
+		AssertThat(std::abs(statistics.StdDev.count() - 3.02765) < 1e-4);
+	}
+
+	// a cheap body is run many times a sample, an expensive one only a few
+	DeclareTest(IterationsAdaptToTarget, Timeout(10s))
+	{
+		BenchmarkOptions options;
+		options.Warmup = 1ms;
+		options.TargetTime = 20ms;
+
+		int counter = 0;
+		auto cheap = TestBenchmark::Measure([&counter]() { DoNotOptimize(++counter); }, options);
+		auto expensive = TestBenchmark::Measure([]() { Spin(200us); }, options);
+
+		AssertThat(cheap.Samples >= options.MinSamples && cheap.Samples <= options.MaxSamples);
+		AssertThat(cheap.Iterations > 1000 && cheap.Iterations > 100 * expensive.Iterations);
+		AssertThat(expensive.Min >= 200us && expensive.Samples >= options.MinSamples);
+		AssertThat(cheap.Min <= cheap.Median && cheap.Median <= cheap.P90 && cheap.P90 <= cheap.P99 && cheap.P99 <= cheap.Max);
+	}
+
+	// Run in a worker process as well as here by the tests below
+	DeclareTestSubCategory(FrameworkMeasurement, Targets)
+	{
+		DeclareBenchmark(Benchmarked, Warmup(1ms), TargetTime(5ms))
+		{
+			Spin(10us);
+		}
+	}
+
+	// the statistics are kept with the result, and survive the trip back from a worker process
+	DeclareTest(BenchmarksRecordStatistics, Timeout(10s))
+	{
+		for (auto isolation : { TestIsolation::Thread, TestIsolation::Process })
+		{
+			if (isolation == TestIsolation::Process && !TestProcessPool::IsSupported())
+				continue;
+
+			RegisteredSuite suite;
+			suite.Add("FrameworkMeasurement/Targets/Benchmarked");
+			AssertThat(suite.Tests[0]->Concurrency == TestConcurrency::Exclusive);
+
+			auto options = TestExecutionOptions().ForceOntoMainThread();
+			options.Isolation = isolation;
+
+			TestRunner runner;
+			auto contexts = suite.Contexts();
+			runner.Run(contexts, options);
+
+			const auto& result = suite.Results[0];
+			auto measured = result.Measurements();
+			AssertThat(result.HasRun() && result.HasPassed() && measured != nullptr);
+			const auto& statistics = measured->Benchmark;
+			AssertThat(statistics && statistics->Samples >= 5 && statistics->Mean >= 10us);
+		}
+	}
+
+	DeclareTest(MannWhitneyDetectsShifts)
+	{
+		std::vector<double> baseline, same, slower, faster, slightlySlower;
+		for (int i = 0; i < 20; ++i)
+		{
+			double sample = 100.0 + (i * 7) % 10;
+			baseline.push_back(sample);
+			same.push_back(100.0 + (i * 3) % 10);
+			slower.push_back(sample * 1.3);
+			faster.push_back(sample * 0.7);
+			slightlySlower.push_back(sample + 3.0);
+		}
+
+		auto unchanged = TestBaselines::Compare(baseline, same, 0.1, 0.01);
+		AssertThat(!unchanged.Regressed && !unchanged.Improved && unchanged.PValue > 0.01);
+
+		auto regressed = TestBaselines::Compare(baseline, slower, 0.1, 0.01);
+		AssertThat(regressed.Regressed && regressed.PValue < 0.001 && std::abs(regressed.Ratio - 1.3) < 0.05);
+
+		AssertThat(TestBaselines::Compare(baseline, faster, 0.1, 0.01).Improved);
+
+		// significant, but within the threshold
+		auto within = TestBaselines::Compare(baseline, slightlySlower, 0.1, 0.01);
+		AssertThat(within.PValue < 0.01 && !within.Regressed);
+	}
+
+	// a benchmark slower than its baseline fails like any other test, one without a baseline records it
+	DeclareTest(RegressionsFailTheBenchmark, Timeout(10s))
+	{
+		SyntheticSuite suite;
+		suite.Add(2, []() { TestBenchmark::Run([]() { Spin(10us); }, BenchmarkOptions{ 1ms, 5ms }); });
+
+		TestRunner runner;
+		const std::vector<double> fast(10, 1.0);
+		runner._baselines.Record(TestHistory::KeyOf(*suite.Root.Children[0]), fast);
+
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		AssertThat(suite.Results[0].Status() == TestResultStatus::Failed);
+		AssertThat(suite.Results[0].LastFailure()->error().find("slower than its baseline") != std::string::npos);
+		AssertThat(suite.Results[1].Status() == TestResultStatus::Passed);
+		AssertThat(runner._baselines.Size() == 2);
+
+		// the regression doesn't replace the baseline, and baselines survive a round trip through the file
+		auto file = std::filesystem::temp_directory_path() / "TestBaselines_RegressionsFailTheBenchmark.txt";
+		AssertThat(runner._baselines.Save(file));
+
+		TestBaselines loaded;
+		AssertThat(loaded.Load(file) && loaded.Size() == 2);
+		AssertThat(*loaded.Find(TestHistory::KeyOf(*suite.Root.Children[0])) == fast);
+		std::filesystem::remove(file);
+
+		// accepting takes the slower run as the baseline, so it passes
+		TestExecutionOptions accepting;
+		accepting.AcceptBaselines = true;
+		runner.Run(contexts, accepting.ForceOntoMainThread());
+		AssertThat(suite.Results[0].Status() == TestResultStatus::Passed);
+		AssertThat(*runner._baselines.Find(TestHistory::KeyOf(*suite.Root.Children[0])) != fast);
+	}
+
+	// each instance of a parameterized benchmark is held to a baseline of its own
+	DeclareTest(InstancesHaveBaselines, Timeout(10s))
+	{
+		TestRunner runner;
+		SyntheticInstances instances(runner, 3, 10ms, [](int)
+		{
+			TestBenchmark::Run([]() { Spin(10us); }, BenchmarkOptions{ 1ms, 5ms });
+		});
+
+		const std::vector<double> fast(10, 1.0);
+		auto key = TestHistory::KeyOf(*instances.Test->Children[0]);
+		runner._baselines.Record(key + "[1]", fast);
+
+		auto contexts = instances.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		AssertThat(instances.Result.Status() == TestResultStatus::Failed);
+		AssertThat(instances.Result.LastFailure()->error().starts_with("Instances(1): "));
+		AssertThat(runner._baselines.Size() == 3 && runner._baselines.Find(key + "[0]") && runner._baselines.Find(key + "[2]"));
+		AssertThat(instances.Result.Instances()->Read().Benchmarks.size() == 3);
+	}
+
+	// whichever counters the kernel lets us open are kept with the result, without any the result has none
+	DeclareTest(CountersAreCollectedWhereAvailable, Timeout(10s))
+	{
+		SyntheticSuite suite;
+		suite.Add(1, []()
+		{
+			for (int i = 0; i < 5; ++i)
+				std::this_thread::sleep_for(1ms);
+		});
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+		AssertThat(suite.Results[0].Status() == TestResultStatus::Passed);
+
+		auto available = TestCounters::Available();
+		auto measured = suite.Results[0].Measurements();
+		AssertThat(measured != nullptr);
+		const auto& counters = measured->Counters;
+		if (available == 0)
+		{
+			AssertThat(!counters);
+			return;
+		}
+
+		AssertThat(counters && counters->Available == available);
+		if (counters->IsAvailable(TestCounter::ContextSwitches))
+			AssertThat((*counters)[TestCounter::ContextSwitches] >= 5);
+		if (counters->IsAvailable(TestCounter::Instructions))
+			AssertThat((*counters)[TestCounter::Instructions] > 0);
+	}
+
+	// a test that sleeps is mostly off the cpu by its own choice, one that spins is on it throughout
+	DeclareTest(UsageSeparatesWaitingFromComputing, Timeout(10s))
+	{
+		SyntheticSuite suite;
+		suite.Add(1, []()
+		{
+			for (int i = 0; i < 5; ++i)
+				std::this_thread::sleep_for(2ms);
+		});
+		suite.Add(1, []() { Spin(10ms); });
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+		AssertThat(suite.AllPassed());
+
+		auto waitingMeasured = suite.Results[0].Measurements();
+		auto computingMeasured = suite.Results[1].Measurements();
+		AssertThat(waitingMeasured != nullptr && computingMeasured != nullptr);
+		const auto& waiting = waitingMeasured->Usage;
+		const auto& computing = computingMeasured->Usage;
+		if (!TestUsage::Start())
+		{
+			AssertThat(!waiting && !computing);
+			return;
+		}
+
+		AssertThat(waiting && computing);
+		AssertThat(waiting->WallTime >= 10ms && waiting->CpuShare() < 0.5 && waiting->VoluntarySwitches >= 5);
+		AssertThat(computing->WallTime >= 10ms && computing->CpuTime > 0ns && computing->CpuTime <= computing->WallTime);
+	}
+
+	// only tracked with the allocator hooked, without it there's nothing recorded and budgets can't fail
+	DeclareTest(AllocationBudgetsAreEnforced, Timeout(10s))
+	{
+		SyntheticSuite suite;
+		suite.Add(1, []()
+		{
+			std::vector<std::unique_ptr<int>> values;
+			for (int i = 0; i < 100; ++i)
+				values.push_back(std::make_unique<int>(i));
+		});
+		suite.Add(1, []() { DoNotOptimize(std::make_unique<std::array<char, 4096>>()); });
+		suite.Add(1, []() { DoNotOptimize(std::make_unique<int>(0)); });
+		suite.Root.Children[0]->Definition->MaxAllocations = 10;
+		suite.Root.Children[2]->Definition->MaxAllocations = 1;
+
+		TestRunner runner;
+		auto contexts = suite.Contexts();
+		runner.Run(contexts, TestExecutionOptions().ForceOntoMainThread());
+
+		if (!TestAllocations::IsHooked())
+		{
+			AssertThat(suite.AllPassed() && !suite.Results[0].Measurements()->Allocations);
+			return;
+		}
+
+		auto manyMeasured = suite.Results[0].Measurements();
+		const auto& many = manyMeasured->Allocations;
+		AssertThat(suite.Results[0].Status() == TestResultStatus::Failed);
+		AssertThat(suite.Results[0].LastFailure()->error().find("over its budget of 10") != std::string::npos);
+		AssertThat(many && many->Allocations >= 100 && many->Allocations == many->Deallocations);
+
+		auto largeMeasured = suite.Results[1].Measurements();
+		const auto& large = largeMeasured->Allocations;
+		AssertThat(suite.Results[1].Status() == TestResultStatus::Passed);
+		AssertThat(large && large->Allocations == 1 && large->PeakBytes >= 4096);
+
+		AssertThat(suite.Results[2].Status() == TestResultStatus::Passed);
+	}
+}